@@ -0,0 +1,79 @@
+/* Benchmark of the cost of compiling: best wall time and peak memory of
+ * compiler invocations, e.g. of a translation unit including `roundlib.hpp`.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <fmt/base.h>
+
+extern char** environ;
+
+
+// run `argv` `reps` times, return the best wall time (s) and the peak
+// resident memory (MiB) of the process and of its children (e.g. cc1plus)
+std::pair<double, double> measure(std::vector<char*>& argv, int reps)
+{
+        double best = 1e30, rss = 0;
+        for (int r = 0; r < reps; ++r) {
+                pid_t pid;
+                int status;
+                rusage ru{};
+                auto t0 = std::chrono::steady_clock::now();
+                if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0
+                    || wait4(pid, &status, 0, &ru) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        fmt::println("# error: cannot run {}", argv[0]);
+                        std::exit(1);
+                }
+                auto t1 = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+                rss  = std::max(rss, ru.ru_maxrss / 1024.);
+        }
+        return {best, rss};
+}
+
+
+// usage: compile reps label command... [-- label command...]
+int main(int argc, char** argv)
+{
+        if (argc < 4) {
+                fmt::println("# usage: {} reps label command... [-- label command...]", argv[0]);
+                return 1;
+        }
+        const int reps = std::atoi(argv[1]);
+
+        fmt::println("# best of {} compilations", reps);
+        fmt::println("{:<24} {:>10} {:>10}", "# translation unit", "time (s)", "mem (MiB)");
+        for (int i = 2; i < argc; ++i) {
+                const char* label = argv[i++];
+                std::vector<char*> cmd;
+                for (; i < argc && std::strcmp(argv[i], "--") != 0; ++i) cmd.push_back(argv[i]);
+                cmd.push_back(nullptr);
+                auto [t, m] = measure(cmd, reps);
+                fmt::println("{:<24} {:>10.2f} {:>10.1f}", label, t, m);
+        }
+        return 0;
+}
@@ -0,0 +1,40 @@
+/* Translation unit for the compile-time benchmark: includes `roundlib.hpp`
+ * and instantiates `format` for common types (only fmt with -DWITHOUT_ROUNDLIB).
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <fmt/base.h>
+
+#ifndef WITHOUT_ROUNDLIB
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "roundlib.hpp"
+
+std::string f1(double v, double e) { return rounder::format(v, e); }
+std::string f2(float v, float e) { return rounder::format(v, e); }
+std::string f3(int v, int e) { return rounder::format(v, e); }
+std::string f4(const char* v, const char* e) { return rounder::format(v, e); }
+std::string f5(const std::string& v, const std::string& e) { return rounder::format(v, e); }
+std::string f6(std::string_view v, std::string_view e) { return rounder::format(v, e); }
+std::string f7(double v, const std::vector<double>& e) { return rounder::format(v, e); }
+std::string f8(const std::string& v, const std::vector<std::string>& e) { return rounder::format(v, e); }
+#endif
+
+void print(std::string_view s) { fmt::println("{}", s); }
@@ -0,0 +1,137 @@
+/* Benchmark of the rounding rules on three-digit mantissas:
+ * branchy rules vs. precomputed tables.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <fmt/base.h>
+
+#include "roundlib.hpp"
+
+using rounder::number;
+
+
+// the rules before the tables: PDG rule for a three-digit mantissa, up
+// to 354 keep two digits, up to 949 keep one digit, above round to 1000
+// and keep two digits
+void pdg_branchy(number& n)
+{
+        if (n.n <= 354) {
+                int u = n.n % 10;
+                n.n /= 10;
+                if (u >= 5) ++n.n;
+                ++n.p;
+                return;
+        }
+        if (n.n <= 949) {
+                int d = (n.n / 10) % 10;
+                n.n /= 100;
+                n.p += 2;
+                if (d >= 5) ++n.n;
+                return;
+        }
+        n.n = 10;
+        n.p += 2;
+}
+
+
+void twodig_branchy(number& n)
+{
+        int u = n.n % 10;
+        n.n /= 10;
+        if (u >= 5) ++n.n;
+        ++n.p;
+}
+
+
+// time `f` over `reps` passes on a fresh copy of the input, return ns per number
+template <typename F>
+double time_it(const std::vector<number>& in, int reps, F f)
+{
+        std::vector<number> v;
+        double best = 1e30;
+        std::uint64_t sink = 0;
+        for (int r = 0; r < reps; ++r) {
+                v = in;
+                auto t0 = std::chrono::steady_clock::now();
+                f(v);
+                auto t1 = std::chrono::steady_clock::now();
+                best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count());
+                sink += v[r % v.size()].n;
+        }
+        if (sink == 42) fmt::println("");  // keep the results alive
+        return best / in.size();
+}
+
+
+int main(int argc, char** argv)
+{
+        std::size_t size = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+        const int reps = 20;
+
+        // the tables must reproduce the rules
+        for (std::uint64_t m = 100; m < 1000; ++m) {
+                number a{}, b{};
+                a.n = b.n = m;
+                pdg_branchy(a);
+                rounder::detail::apply_rule(b, rounder::detail::pdg_table<>);
+                number c{}, d{};
+                c.n = d.n = m;
+                twodig_branchy(c);
+                rounder::detail::apply_rule(d, rounder::detail::twodig_table);
+                if (a.n != b.n || a.p != b.p || c.n != d.n || c.p != d.p) {
+                        fmt::println("# error: table mismatch for mantissa {}", m);
+                        return 1;
+                }
+        }
+
+        std::mt19937_64 rng(12345);
+        std::uniform_int_distribution<std::uint64_t> mant(100, 999);
+        std::vector<number> in(size);
+        for (auto& n : in) {
+                n.n = mant(rng);
+                n.p = -3;
+        }
+
+        fmt::println("# {} random three-digit mantissas, best of {} passes", size, reps);
+        fmt::println("{:<24} {:>10}", "# rule", "ns/number");
+        auto report = [](const char* name, double ns) { fmt::println("{:<24} {:>10.3f}", name, ns); };
+
+        report("pdg branchy", time_it(in, reps, [](std::vector<number>& v) {
+                for (auto& n : v) pdg_branchy(n);
+        }));
+        report("pdg table", time_it(in, reps, [](std::vector<number>& v) {
+                for (auto& n : v) rounder::detail::apply_rule(n, rounder::detail::pdg_table<>);
+        }));
+        report("pdg_round single", time_it(in, reps, [](std::vector<number>& v) {
+                for (auto& n : v) rounder::detail::pdg_round(n, true);
+        }));
+        report("twodigits branchy", time_it(in, reps, [](std::vector<number>& v) {
+                for (auto& n : v) twodig_branchy(n);
+        }));
+        report("twodigits table", time_it(in, reps, [](std::vector<number>& v) {
+                for (auto& n : v) rounder::detail::apply_rule(n, rounder::detail::twodig_table);
+        }));
+        report("twodig_round single", time_it(in, reps, [](std::vector<number>& v) {
+                for (auto& n : v) rounder::detail::twodig_round(n, true);
+        }));
+        return 0;
+}
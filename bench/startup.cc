@@ -0,0 +1,73 @@
+/* Benchmark of the startup cost of executables run once per call, as
+ * `round` in shell pipelines: average wall time of spawning and waiting.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include <chrono>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/base.h>
+
+extern char** environ;
+
+
+// run `path` with a typical measurement `calls` times, return µs per call
+double time_calls(const char* path, int calls)
+{
+        char* argv[] = {const_cast<char*>(path), const_cast<char*>("27.462"),
+                        const_cast<char*>("0.3234"), nullptr};
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) {
+                pid_t pid;
+                int status;
+                if (posix_spawn(&pid, path, &fa, nullptr, argv, environ) != 0
+                    || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        fmt::println("# error: cannot run {}", path);
+                        std::exit(1);
+                }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        posix_spawn_file_actions_destroy(&fa);
+        return std::chrono::duration<double, std::micro>(t1 - t0).count() / calls;
+}
+
+
+int main(int argc, char** argv)
+{
+        if (argc < 3) {
+                fmt::println("# usage: {} calls executable...", argv[0]);
+                return 1;
+        }
+        const int calls = std::atoi(argv[1]);
+
+        fmt::println("# {} calls per executable", calls);
+        fmt::println("{:<24} {:>10}", "# executable", "us/call");
+        for (int i = 2; i < argc; ++i) {
+                time_calls(argv[i], calls / 10 + 1); // warm up the page cache
+                fmt::println("{:<24} {:>10.1f}", argv[i], time_calls(argv[i], calls));
+        }
+        return 0;
+}
@@ -18,13 +18,21 @@
  *  You should have received a copy of the GNU General Public License along
  *  with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 
+#include <unistd.h>
+
 // if you wish to remain header-only also with fmt, compile with
 // `make HEADER_ONLY=1`
 #include <fmt/base.h>
 
 #include "roundlib.hpp"
+#include "roundlib_file.hpp"
+#include "roundlib_table.hpp"
 
 
 int is_digit(char c)
@@ -39,6 +47,8 @@ int is_number(const char* s)
         if (sz < 1) return 0;
         if ('0' <= s[0] && s[0] <= '9') return 1;
         else if ((s[0] == '-' || s[0] == '+')  && is_digit(s[1]))  return 1;
+        else if (s[0] == 'r' && (is_digit(s[1]) || s[1] == '.'))  return 1; // relative error
+        else if ((s[0] == '-' || s[0] == '+')  && s[1] == 'r' && (is_digit(s[2]) || s[2] == '.')) return 1;
         else if ((s[1] == '.' && sz > 2        && is_digit(s[2]))) return 1;
         return 0;
 }
@@ -66,22 +76,144 @@ std::vector<std::string_view> parse_list(std::string_view txt)
 }
 
 
+// a measurement as given on the command line
+struct cli_measurement {
+        std::string_view val;
+        std::vector<std::string_view> errors;
+        std::vector<std::string_view> labels;
+};
+
+
+// feed the standard input to `parser` by chunks, calling `f` for each
+// measurement and `chunk_done` after each chunk
+template <typename F, typename G>
+int read_stdin(rounder::measurement_parser& parser, F&& f, G&& chunk_done)
+{
+        char buf[1 << 16];
+        for (;;) {
+                ssize_t r = ::read(STDIN_FILENO, buf, sizeof(buf));
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0) {
+                        fmt::println("# error: cannot read the standard input");
+                        return 1;
+                }
+                if (r == 0) break;
+                parser.feed(std::string_view(buf, static_cast<std::size_t>(r)), f);
+                chunk_done();
+        }
+        parser.finish(f);
+        chunk_done();
+        return 0;
+}
+
+
+// one measurement per line of the standard input, read in chunks and parsed
+// incrementally: each line is formatted as soon as it is complete, and
+// written after each chunk
+int format_stdin(rounder::format_options opts, const std::vector<std::string_view>& labels,
+                 const rounder::number_syntax& syntax, int sig_digits, bool trailing_newline)
+{
+        opts.labels = labels.empty() ? nullptr : &labels;
+        rounder::measurement_parser parser(syntax);
+        std::string out;
+        bool held = false; // newline not yet written, for `-N`
+        auto emit = [&](rounder::number& central, std::vector<rounder::number>& errors) {
+                if (held) out += '\n';
+                held = false;
+                if (errors.empty()) {
+                        rounder::round_sig(std::span(&central, 1), sig_digits);
+                        rounder::formatter(opts).format_to(out, central, {});
+                } else {
+                        rounder::detail::format_append(out, central, errors, opts);
+                }
+                out += '\n';
+        };
+        // what has arrived is written at once, for interactive pipes
+        auto write = [&] {
+                std::size_t len = out.size();
+                if (!trailing_newline && len) {
+                        --len;
+                        held = true;
+                }
+                std::fwrite(out.data(), 1, len, stdout);
+                std::fflush(stdout);
+                out.clear();
+        };
+        // an invalid line throws, so that the lines before it are written first
+        rounder::detail::recover_errors = true;
+        try {
+                return read_stdin(parser, emit, write);
+        } catch (const rounder::detail::round_error& err) {
+                if (held) out.insert(out.begin(), '\n');
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                fmt::println("{}", err.what());
+                return 1;
+        }
+}
+
+
+// format the rows of a binary file of measurements, one per line; those
+// without errors to `sig_digits` significant digits
+int format_file(const char* path, const rounder::format_options& opts, int sig_digits, bool trailing_newline)
+{
+        rounder::measurement_file f(path);
+        // formatted by blocks of rows, each written and released at once
+        constexpr std::size_t block = 4096;
+        std::vector<std::string> rows(f.size());
+        std::string out;
+        for (std::size_t first = 0; first < f.size(); first += block) {
+                const std::size_t last = std::min(first + block, f.size());
+                f.format_to(rows, first, last, opts, sig_digits);
+                for (std::size_t i = first; i < last; ++i) {
+                        out += rows[i];
+                        if (trailing_newline || i + 1 < f.size()) out += '\n';
+                        std::string().swap(rows[i]);
+                }
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+        }
+        return 0;
+}
+
+
+// store the measurements, all with the same number of errors, in a binary file
+int write_file(const char* path, const std::vector<rounder::measurement>& ms)
+{
+        rounder::measurement_table t(ms.empty() ? 0 : ms.front().errors.size());
+        t.reserve(ms.size());
+        for (const auto& m : ms) t.append(m);
+        std::FILE* f = std::fopen(path, "wb");
+        if (!f || !rounder::write_binary(f, t) || std::fclose(f) != 0) {
+                fmt::println("# error: cannot write {}", path);
+                return 1;
+        }
+        return 0;
+}
+
+
 int main(int argc, char** argv)
 {
         int from_stdin = 0;
         rounder::format_options opts;
-        std::string_view val;
-        std::vector<std::string_view> errors;
-        std::vector<std::string_view> labels;
+        rounder::number_syntax syntax;
+        // several measurements, separated by `--` or `;`, share the same options
+        std::vector<cli_measurement> ms(1);
         bool trailing_newline = true;
+        int sig_digits = 3; // for numbers without errors
+        const char* binary_in  = nullptr; // binary files of measurements
+        const char* binary_out = nullptr;
         // defaults
         opts.round = rounder::format_options::round_algo::pdg;
         opts.prec = rounder::format_options::prec_algo::largest_error;
         for (int i = 1; i < argc; ++i) {
                 const char* c = argv[i];
                 if (is_number(c) && !from_stdin) {
-                        if (val.empty()) val = c;
-                        else errors.emplace_back(c);
+                        if (ms.back().val.empty()) ms.back().val = c;
+                        else ms.back().errors.emplace_back(c);
+                        continue;
+                }
+                if (strcmp(c, "--") == 0 || strcmp(c, ";") == 0) { // next measurement
+                        if (!ms.back().val.empty()) ms.emplace_back();
                         continue;
                 }
                 switch (c[1]) {
@@ -96,6 +228,12 @@ int main(int argc, char** argv)
                                 opts.round = rounder::format_options::round_algo::twodigits;
                                 opts.prec = rounder::format_options::prec_algo::largest_error;
                                 break;
+                        case 'd': // decimal separator
+                                syntax.decimal = argv[++i][0];
+                                break;
+                        case 'g': // characters grouping the digits, skipped
+                                syntax.grouping = argv[++i];
+                                break;
                         case 'e': // round to the total error (quadrature sum of the others, assuming them uncorrelated)
                                 opts.prec = rounder::format_options::prec_algo::total_error;
                                 break;
@@ -124,13 +262,23 @@ int main(int argc, char** argv)
                                 opts.mode = rounder::mode_type::gnuplot;
                                 break;
                         case 'L': // comma-separated list of labels to display after the corresponding errors
-                                labels = parse_list(argv[++i]);
-                                opts.labels = &labels;
-                                // opts.labels = std::move(parse_list(argv[++i]));
+                                ms.back().labels = parse_list(argv[++i]);
+                                break;
+                        case 'P': // errors as percentages of the central value
+                                opts.percent_errors = true;
                                 break;
                         case 'N': // trailing new line
                                 trailing_newline = false;
                                 break;
+                        case 'r': // read (and format) a binary file of measurements
+                                binary_in = argv[++i];
+                                break;
+                        case 'w': // write the measurements to a binary file, instead of formatting them
+                                binary_out = argv[++i];
+                                break;
+                        case 'S': // significant digits of the numbers without errors
+                                sig_digits = std::atoi(argv[++i]);
+                                break;
                         case 'T': // typst
                                 opts.mode = rounder::mode_type::typst;
                                 break;
@@ -145,7 +293,39 @@ int main(int argc, char** argv)
                                 break;
                 }
         }
-        if (trailing_newline) fmt::println("{}", rounder::format(val, errors, opts));
-        else fmt::print("{}", rounder::format(val, errors, opts));
+        if (binary_in) return format_file(binary_in, opts, sig_digits, trailing_newline);
+        if (binary_out && from_stdin) {
+                std::vector<rounder::measurement> rows;
+                rounder::measurement_parser parser(syntax);
+                auto add = [&](rounder::number& central, std::vector<rounder::number>& errors) {
+                        rows.push_back({central, errors, ms.front().labels});
+                };
+                if (int r = read_stdin(parser, add, [] {})) return r;
+                return write_file(binary_out, rows);
+        }
+        if (from_stdin) return format_stdin(opts, ms.front().labels, syntax, sig_digits, trailing_newline);
+        // a trailing separator leaves an empty measurement
+        if (ms.size() > 1 && ms.back().val.empty()) ms.pop_back();
+        if (binary_out) {
+                std::vector<rounder::measurement> rows;
+                for (const auto& m : ms) {
+                        const rounder::number central = rounder::number::from_string(m.val, syntax);
+                        rows.push_back({central, {}, m.labels});
+                        for (auto e : m.errors) rows.back().errors.push_back(rounder::number::from_string(e, central, syntax));
+                }
+                return write_file(binary_out, rows);
+        }
+        for (size_t k = 0; k < ms.size(); ++k) {
+                const auto& m = ms[k];
+                opts.labels = m.labels.empty() ? nullptr : &m.labels;
+                const rounder::number central = rounder::number::from_string(m.val, syntax);
+                std::vector<rounder::number> errors;
+                errors.reserve(m.errors.size());
+                for (auto e : m.errors) errors.push_back(rounder::number::from_string(e, central, syntax));
+                std::string txt = errors.empty() ? rounder::format_sig(central, sig_digits, opts)
+                                                 : rounder::format_numbers(central, std::move(errors), opts);
+                if (trailing_newline || k + 1 < ms.size()) fmt::println("{}", txt);
+                else fmt::print("{}", txt);
+        }
         return 0;
 }
@@ -18,23 +18,154 @@
  *  You should have received a copy of the GNU General Public License along
  *  with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
+#pragma once
+
 #include <algorithm>
 #include <array>
+#include <cctype>
 #include <charconv>
+#include <climits>
 #include <cmath>
+#include <concepts>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <limits>
-#include <regex>
+#include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
 
 // line if you wish to remain header-only also with fmt, compile with `-DFMT_HEADER_ONLY`
 #include <fmt/base.h>
+#include <fmt/core.h> // fmt::vformat
+
+// with many translation units including this header, compile them with
+// `-DROUNDLIB_EXTERN_TEMPLATES` to skip the code of the rounding and formatting
+// kernels, and one of them also with `-DROUNDLIB_INSTANTIATE` to compile it once
+#if defined(ROUNDLIB_INSTANTIATE)
+#define ROUNDLIB_TEMPLATE template
+#elif defined(ROUNDLIB_EXTERN_TEMPLATES)
+#define ROUNDLIB_TEMPLATE extern template
+#endif
 
 namespace rounder {
 
+namespace detail {
+
+// a number that cannot be read or rounded
+struct round_error : std::runtime_error {
+        using std::runtime_error::runtime_error;
+};
+
+// threads that must not end the program (the background threads of the
+// logger and of the sink) set this: the errors are then thrown as round_error
+inline thread_local bool recover_errors = false;
+
+// print the error and exit, or throw it if `recover_errors`: formatted
+// once, by a single function whatever the arguments
+[[noreturn]] inline void vfail(fmt::string_view f, fmt::format_args args)
+{
+        std::string msg = fmt::vformat(f, args);
+        if (recover_errors) throw round_error(msg);
+        msg += '\n';
+        std::fwrite(msg.data(), 1, msg.size(), stdout);
+        std::exit(1);
+}
+
+template <typename... T>
+[[noreturn]] inline void fail(fmt::format_string<T...> f, T&&... args)
+{
+        vfail(f, fmt::make_format_args(args...));
+}
+
+// print a warning with the results on the standard output, or on the
+// standard error from the background threads, not to mix it with the
+// measurements they write
+inline void warn(const char* msg)
+{
+        std::FILE* f = recover_errors ? stderr : stdout;
+        std::fputs(msg, f);
+        std::fputc('\n', f);
+}
+
+
+// unsigned 128-bit integer for the exact products of two mantissas,
+// in portable code (no compiler extension)
+struct uint128 {
+        std::uint64_t hi = 0;
+        std::uint64_t lo = 0;
+
+        constexpr bool fits_64() const noexcept { return hi == 0; }
+        friend constexpr bool operator<(const uint128& a, const uint128& b) noexcept
+        {
+                return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+        }
+};
+
+// full product of two 64-bit integers
+constexpr uint128 mul_64(std::uint64_t a, std::uint64_t b) noexcept
+{
+        const std::uint64_t a0 = a & 0xffffffffu, a1 = a >> 32;
+        const std::uint64_t b0 = b & 0xffffffffu, b1 = b >> 32;
+        const std::uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+        const std::uint64_t mid = (p00 >> 32) + (p01 & 0xffffffffu) + (p10 & 0xffffffffu);
+        return {p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32), (mid << 32) | (p00 & 0xffffffffu)};
+}
+
+// `a` times a small factor, which must not overflow
+constexpr uint128 mul_small(const uint128& a, std::uint32_t m) noexcept
+{
+        const uint128 lo = mul_64(a.lo, m);
+        return {a.hi * m + lo.hi, lo.lo};
+}
+
+// divide `a` in place by a small divisor, return the remainder
+constexpr std::uint32_t divmod_small(uint128& a, std::uint32_t d) noexcept
+{
+        const std::uint64_t hq = a.hi / d, hr = a.hi % d;
+        // the remainder of the high part and the low part, by halves
+        const std::uint64_t mid = (hr << 32) | (a.lo >> 32);
+        const std::uint64_t mq = mid / d, mr = mid % d;
+        const std::uint64_t low = (mr << 32) | (a.lo & 0xffffffffu);
+        a = {hq, (mq << 32) | (low / d)};
+        return static_cast<std::uint32_t>(low % d);
+}
+
+// quotient of `a` by `d`, when it fits in 64 bits (a.hi < d)
+constexpr std::uint64_t div_64(const uint128& a, std::uint64_t d) noexcept
+{
+        std::uint64_t r = a.hi, lo = a.lo, q = 0;
+        for (int i = 0; i < 64; ++i) {
+                const bool carry = r >> 63;
+                r  = (r << 1) | (lo >> 63);
+                lo <<= 1;
+                q <<= 1;
+                if (carry || r >= d) {
+                        r -= d;
+                        q |= 1;
+                }
+        }
+        return q;
+}
+
+} // namespace detail
+
+// textual syntax of numbers: decimal separator and digit grouping characters
+// (single bytes, a multi-byte separator such as U+00A0 is given by its bytes)
+struct number_syntax {
+        char decimal              = '.';
+        std::string_view grouping = {};
+};
+
+
 /*------------------------------------
  * decimal representation of a number
  *------------------------------------*/
@@ -68,8 +199,7 @@ struct number {
                 auto [num_ptr, ec] = std::to_chars(ptr, buf + sizeof(buf), v);
 
                 if (ec != std::errc{}) {
-                        fmt::println("# error: cannot convert {}", v);
-                        std::exit(1);
+                        detail::fail("# error: cannot convert {}", v);
                 }
                 return from_string(std::string_view{buf, static_cast<std::size_t>(num_ptr - buf)});
         }
@@ -77,6 +207,14 @@ struct number {
 
         // constructor from a string-like object
         static number from_string(std::string_view sv)
+        {
+                return from_string(sv, number_syntax{});
+        }
+
+
+        // as above, with the given decimal separator, skipping the grouping
+        // characters (e.g. `1.234,5` or `1 234.5`) in the same scanning pass
+        static number from_string(std::string_view sv, const number_syntax& syntax)
         {
                 number res{};
 
@@ -86,8 +224,7 @@ struct number {
                 while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.back())))
                         sv.remove_suffix(1);
                 if (sv.empty()) {
-                        fmt::println("# error: empty number {}", sv);
-                        std::exit(1);
+                        detail::fail("# error: empty number {}", sv);
                 }
 
                 // sign
@@ -101,51 +238,88 @@ struct number {
                         res.sgn = 0;
                 }
 
-                // scan digits
-                std::size_t dot    = std::string_view::npos;
+                // scan digits, building the mantissa
+                std::uint64_t mant = 0;
+                bool dot           = false;
+                int after          = 0; // digits after the decimal separator
                 std::size_t digits = 0;
-                for (std::size_t i = 0; i < sv.size(); ++i) {
-                        char c = sv[i];
-                        if (c == '.') {
-                                if (dot != std::string_view::npos) {
-                                        fmt::println("# error: multiple " "decimal points in {}", sv);
-                                        std::exit(1);
+                for (char c : sv) {
+                        if ('0' <= c && c <= '9') {
+                                int d = c - '0';
+                                if (mant > (std::numeric_limits<std::uint64_t>::max() - d) / 10) {
+                                        detail::fail("# error: mantissa overflow for {}", sv);
                                 }
-                                dot = i;
-                        } else if (std::isdigit(static_cast<unsigned char>(c))) {
+                                mant = mant * 10 + static_cast<std::uint64_t>(d);
+                                after += dot;
                                 ++digits;
-                        } else {
-                                fmt::println("# error: invalid character in {}", sv);
-                                std::exit(1);
+                        } else if (c == syntax.decimal) {
+                                if (dot) {
+                                        detail::fail("# error: multiple " "decimal points in {}", sv);
+                                }
+                                dot = true;
+                        } else if (syntax.grouping.find(c) == std::string_view::npos) {
+                                detail::fail("# error: invalid character in {}", sv);
                         }
                 }
                 if (digits == 0) {
-                        fmt::println("# error: no digits in {}", sv);
-                        std::exit(1);
-                }
-
-                // mantissa
-                std::uint64_t mant = 0;
-                // for (std::size_t i = 0; i < end; ++i) {
-                for (std::size_t i = 0; i < sv.size(); ++i) {
-                        char c = sv[i];
-                        if (c == '.') continue;
-                        int d = c - '0';
-                        if (mant > (std::numeric_limits<std::uint64_t>::max() - d) / 10) {
-                                fmt::println("# error: mantissa overflow for {}", sv);
-                                std::exit(1);
-                        }
-                        mant = mant * 10 + static_cast<std::uint64_t>(d);
+                        detail::fail("# error: no digits in {}", sv);
                 }
                 res.n = mant;
+                res.p = -after;
+                return res;
+        }
 
-                // exponent
-                if (dot == std::string_view::npos) {
-                        res.p = 0;
+
+        // an error relative to `central`, given as a fraction (`r0.05`) or a
+        // percentage (`5%`), converted exactly to an absolute error; any other
+        // text is parsed as an absolute error
+        static number from_string(std::string_view sv, const number& central,
+                                  const number_syntax& syntax = {})
+        {
+                while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.front())))
+                        sv.remove_prefix(1);
+                while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.back())))
+                        sv.remove_suffix(1);
+                int sgn = 0;
+                std::string_view v = sv;
+                if (!v.empty() && (v.front() == '+' || v.front() == '-')) {
+                        sgn = v.front() == '+' ? +1 : -1;
+                        v.remove_prefix(1);
+                }
+                int shift = 0; // power of 10 dividing the relative value
+                if (!v.empty() && v.front() == 'r') {
+                        v.remove_prefix(1);
+                } else if (!v.empty() && v.back() == '%') {
+                        v.remove_suffix(1);
+                        shift = 2;
                 } else {
-                        int after = static_cast<int>(sv.size() - dot - 1);
-                        res.p     = -after;
+                        return from_string(sv, syntax);
+                }
+                if (v.empty() || v.front() == '+' || v.front() == '-') {
+                        detail::fail("# error: invalid relative error {}", sv);
+                }
+                number rel = from_string(v, syntax);
+                rel.sgn    = sgn;
+                rel.p -= shift;
+                return from_relative(rel, central);
+        }
+
+
+        // absolute error from the fraction `rel` of `central` (sign of `rel`):
+        // the exact product of the mantissas, rounded only beyond 64 bits
+        static number from_relative(const number& rel, const number& central)
+        {
+                detail::uint128 m = detail::mul_64(rel.n, central.n);
+                number res;
+                res.p   = rel.p + central.p;
+                res.sgn = rel.sgn;
+                unsigned last = 0;
+                while (!m.fits_64()) {
+                        last = detail::divmod_small(m, 10);
+                        ++res.p;
                 }
+                res.n = m.lo;
+                if (last >= 5 && res.n < std::numeric_limits<std::uint64_t>::max()) ++res.n;
                 return res;
         }
 
@@ -220,6 +394,30 @@ struct number {
 };
 
 
+// An asymmetric error as one element: upper and lower errors, whatever the
+// signs they are given with (the magnitudes are kept).
+struct asym_error {
+        number up;
+        number down;
+
+        constexpr asym_error() noexcept { up.sgn = +1; down.sgn = -1; }
+        asym_error(number u, number d) : up(u), down(d)
+        {
+                up.sgn   = +1;
+                down.sgn = -1;
+        }
+};
+
+// An error of a measurement: symmetric, or an asymmetric pair. Rows of
+// `error_element`s carry the pairing in their structure, instead of
+// adjacent `number`s with sgn = +1/-1 to be paired by position.
+using error_element = std::variant<number, asym_error>;
+
+
+// how the digits dropped when rounding to a precision break ties
+enum class tie_rule { half_up, half_even };
+
+
 /*------------------
  * helpers to round
  *------------------*/
@@ -238,90 +436,230 @@ inline int digit_count(std::uint64_t v)
 }
 
 
-inline number quadrature_sum(const std::vector<number> &vec)
+// call `f(j, e)` for each error of a row of adjacent `number`s, `j` being
+// its position: `e` is an asym_error for two adjacent signed errors (the
+// first as upper), the number otherwise. Return the number of signed
+// errors without a partner. The only place where the pairs are inferred.
+template <typename F>
+inline std::size_t for_each_element(std::span<const number> errors, F&& f)
 {
-        if (vec.size() == 1) return vec[0];
+        std::size_t unpaired = 0;
+        for (std::size_t j = 0; j < errors.size(); ++j) {
+                if (errors[j].sgn != 0 && j + 1 < errors.size() && errors[j + 1].sgn != 0) {
+                        f(j, asym_error(errors[j], errors[j + 1]));
+                        ++j;
+                        continue;
+                }
+                if (errors[j].sgn != 0) ++unpaired;
+                f(j, errors[j]);
+        }
+        return unpaired;
+}
+
+
+inline void warn_unpaired()
+{
+        detail::warn("# warning: asymmetric errors do not seem to come in pairs");
+}
+
+
+// compensated sum of the squares of the errors, by element type
+struct square_sum {
         double sum = 0;
         double c   = 0;
-        size_t cnt = 0;
-        double pe  = 0.; // previous error (asymmetric case)
-        for (const auto &e : vec) {
-                double v = e.to_double();
+
+        void add(double v)
+        {
                 double y = v * v - c;
-                // if the first asymmetric error already summed
-                // was not the larger of the two, take the second
-                if (e.sgn == 0 && cnt % 2 == 1) {
-                        if (fabs(v) < pe) {
-                                ++cnt;
-                                continue;
-                        } else y -= pe * pe;
-                }
                 double t = sum + y;
                 c        = (t - sum) - y;
                 sum      = t;
-                // store the first of the two asymmetric errors
-                if (e.sgn != 0) {
-                        ++cnt;
-                        pe = fabs(v);
-                }
         }
-        if (cnt % 2 != 0) {
-                fmt::println("# warning: asymmetric errors do not seem to come in pairs");
-                fmt::println("# warning: the total error computation may be wrong.");
+        void operator()(const number& e) { add(e.to_double()); }
+        void operator()(const asym_error& e)
+        {
+                add(e.up.to_double());
+                add(e.down.to_double());
         }
-        return number::from_numeric(std::sqrt(sum));
+        number root() const { return number::from_numeric(std::sqrt(sum)); }
 };
 
 
-// keep three most significant digits
-inline void keep_three_sig(number& n, bool quiet)
+inline number quadrature_sum(std::span<const error_element> vec)
+{
+        if (vec.size() == 1 && std::holds_alternative<number>(vec[0])) return std::get<number>(vec[0]);
+        square_sum s;
+        for (const auto& e : vec) std::visit(s, e);
+        return s.root();
+}
+
+
+// as above, for adjacent `number`s
+inline number quadrature_sum(std::span<const number> vec)
+{
+        if (vec.size() == 1) return vec[0];
+        square_sum s;
+        if (for_each_element(vec, [&s](std::size_t, const auto& e) { s(e); }) != 0) {
+                warn_unpaired();
+                detail::warn("# warning: the total error computation may be wrong.");
+        }
+        return s.root();
+}
+
+
+// keep the `digits` most significant digits (truncating), pad with zeros if fewer
+inline void keep_sig_digits(number& n, int digits, bool quiet)
 {
         int nd = digit_count(n.n);
-        if (nd < 3 && !quiet) {
-                fmt::println("# warning: not enough significant digits, padding with zeros");
+        if (nd < digits && !quiet) {
+                detail::warn("# warning: not enough significant digits, padding with zeros");
         }
-        if (nd == 1) {
-                n.n *= 100;
-                n.p -= 2;
-        } else if (nd == 2) {
+        for (; nd < digits; ++nd) {
                 n.n *= 10;
-                n.p -= 1;
-        } else {
-                int drop = nd - 3;
-                while (drop--) {
-                        n.n /= 10;
-                        ++n.p;
-                }
+                --n.p;
+        }
+        for (; nd > digits; --nd) {
+                n.n /= 10;
+                ++n.p;
         }
 }
 
 
-// PDG rule for a three‑digit mantissa
-inline void pdg_rule(number& n)
+// keep three most significant digits
+inline void keep_three_sig(number& n, bool quiet)
 {
-        int cnt = digit_count(n.n);
-        if (cnt != 3) {
-                fmt::println("# error: number {} does not have 3 digits", n.n);
-                std::exit(1);
-        }
-        if (100 <= n.n && n.n <= 354) {
-                int u = n.n % 10;
+        keep_sig_digits(n, 3, quiet);
+}
+
+
+inline constexpr auto pow10_table = [] {
+        std::array<std::uint64_t, 20> t{};
+        t[0] = 1;
+        for (std::size_t i = 1; i < t.size(); ++i) t[i] = t[i - 1] * 10;
+        return t;
+}();
+
+
+// round half up to `digits` significant digits (padding with zeros as
+// `keep_sig_digits`), zero is left as is; `digits` is in [1, 19]
+inline void round_sig_digits(number& n, int digits)
+{
+        if (n.n == 0) return;
+        const int nd = digit_count(n.n);
+        const bool up = nd > digits && n.n % pow10_table[nd - digits] >= pow10_table[nd - digits] / 2;
+        keep_sig_digits(n, digits, true);
+        if (up && ++n.n == pow10_table[digits]) { // 999.6 -> 1000
                 n.n /= 10;
-                if (u >= 5) ++n.n;
                 ++n.p;
-                return;
         }
-        if (355 <= n.n && n.n <= 949) {
-                int d = (n.n / 10) % 10;
-                n.n /= 100;
-                n.p += 2;
-                if (d >= 5) ++n.n;
+}
+
+
+inline void round_sig_digits(std::span<number> v, int digits)
+{
+        for (auto& n : v) round_sig_digits(n, digits);
+}
+
+
+// the error `e` as a percentage of `central`, with the significant digits
+// of `e` (rounded half up)
+inline number percent_of(const number& e, const number& central)
+{
+        if (central.n == 0) {
+                detail::fail("# error: percent error of a null central value");
+        }
+        number r;
+        r.sgn = e.sgn;
+        if (e.n == 0) return r;
+        const int digits = std::min(digit_count(e.n), 18);
+        uint128 num{0, e.n}, den{0, central.n};
+        for (int i = 0; i < digits; ++i) den = mul_small(den, 10);
+        // quotient with at least one digit more than needed
+        int k = 0;
+        for (; num < den; ++k) num = mul_small(num, 10);
+        std::uint64_t q = div_64(num, central.n);
+        r.p = e.p - central.p + 2 - k;
+        int nd = digit_count(q);
+        for (; nd > digits + 1; --nd) {
+                q /= 10;
+                ++r.p;
+        }
+        r.n = q / 10 + (q % 10 >= 5);
+        ++r.p;
+        if (digit_count(r.n) > digits) { // 99.5 -> 100
+                r.n /= 10;
+                ++r.p;
+        }
+        return r;
+}
+
+
+// outcome of a rounding rule for a three-digit mantissa:
+// rounded mantissa and increment of the exponent
+struct rule_entry {
+        std::uint8_t n;
+        std::uint8_t dp;
+};
+
+
+template <std::uint64_t Two = 354, std::uint64_t One = 949>
+constexpr rule_entry pdg_entry(std::uint64_t m)
+{
+        if (m <= Two) return {static_cast<std::uint8_t>(m / 10 + (m % 10 >= 5)), 1};
+        if (m <= One) return {static_cast<std::uint8_t>(m / 100 + ((m / 10) % 10 >= 5)), 2};
+        return {10, 2};
+}
+
+
+constexpr rule_entry twodig_entry(std::uint64_t m)
+{
+        return {static_cast<std::uint8_t>(m / 10 + (m % 10 >= 5)), 1};
+}
+
+
+// the outcome for every mantissa in [100, 999], precomputed at compile time;
+// `zero_ok` if the rule also accepts a null mantissa (a null error)
+struct rule_table {
+        std::array<rule_entry, 900> entries;
+        bool zero_ok;
+};
+
+template <typename F>
+constexpr rule_table make_rule_table(F entry, bool zero_ok)
+{
+        rule_table t{};
+        for (std::uint64_t m = 100; m < 1000; ++m) t.entries[m - 100] = entry(m);
+        t.zero_ok = zero_ok;
+        return t;
+}
+
+template <std::uint64_t Two = 354, std::uint64_t One = 949>
+inline constexpr auto pdg_table = make_rule_table(pdg_entry<Two, One>, false);
+
+inline constexpr auto twodig_table = make_rule_table(twodig_entry, true);
+
+
+// a mantissa outside the table: zero stays zero one digit up if the rule
+// accepts it, as the rules computed digit by digit do
+inline void apply_rule_outside(number& n, const rule_table& t)
+{
+        if (n.n != 0 || !t.zero_ok) {
+                detail::fail("# error: number {} does not have 3 digits", n.n);
+        }
+        ++n.p;
+}
+
+
+// application of a rule table, without branches for three-digit mantissas
+inline void apply_rule(number& n, const rule_table& t)
+{
+        if (n.n - 100 >= 900) [[unlikely]] {
+                apply_rule_outside(n, t);
                 return;
         }
-        // > 950 → round to 1000, keep two sig‑digits
-        n.n = 10;
-        n.p += 2;
-        return;
+        const rule_entry r = t.entries[n.n - 100];
+        n.n  = r.n;
+        n.p += r.dp;
 }
 
 
@@ -329,35 +667,38 @@ inline void pdg_rule(number& n)
 inline void pdg_round(number& n, bool quiet)
 {
         keep_three_sig(n, quiet);
-        pdg_rule(n);
+        apply_rule(n, pdg_table<>);
 }
 
 
-// keep three significant digits then apply the PDG rule
+// keep three significant digits then round to two
 inline void twodig_round(number& n, bool quiet)
 {
         keep_three_sig(n, quiet);
-        int u = n.n % 10;
-        n.n /= 10;
-        if (u >= 5) ++n.n;
-        ++n.p;
+        apply_rule(n, twodig_table);
 }
 
 
 // round to a given precision
+template <tie_rule T = tie_rule::half_up>
 inline void round_to_prec(number& n, int prec)
 {
         if (n.p > prec) {
-                fmt::println("# error: cannot round {} to precision {}", n.to_string(false), prec);
-                std::exit(1);
+                detail::fail("# error: cannot round {} to precision {}", n.to_string(false), prec);
         }
         int d = 0;
+        bool rest = false; // non-zero digits dropped after `d`
         while (n.p < prec) {
+                if constexpr (T == tie_rule::half_even) rest |= d != 0;
                 d = n.n % 10;
                 n.n /= 10;
                 ++n.p;
         }
-        if (d >= 5) ++n.n;
+        if constexpr (T == tie_rule::half_even) {
+                if (d > 5 || (d == 5 && (rest || n.n % 2 == 1))) ++n.n;
+        } else {
+                if (d >= 5) ++n.n;
+        }
 }
 
 
@@ -393,6 +734,17 @@ struct is_container<T, std::void_t<
 template<class T>
 constexpr bool is_container_v = is_container<T>::value;
 
+
+// an error from a number or a text, possibly relative to `central`
+template <typename T>
+inline number error_from_anything(const T& v, const number& central)
+{
+        if constexpr (std::is_convertible_v<T, std::string_view>)
+                return number::from_string(static_cast<std::string_view>(v), central);
+        else
+                return number::from_anything(v);
+}
+
 } // namespace detail
 
 
@@ -416,6 +768,8 @@ struct format_options {
         unsigned factorize_powers    : 1;
         unsigned no_utf8             : 1;
         unsigned cdot                : 1;
+        unsigned deduplicate         : 1; // batch API: format identical rows once
+        unsigned percent_errors      : 1; // display the errors relative to the central value
         unsigned _reserved           : 2; // pad to 1 byte
 
         constexpr format_options()
@@ -429,167 +783,735 @@ struct format_options {
           factorize_powers(0),
           no_utf8(0),
           cdot(0),
+          deduplicate(0),
+          percent_errors(0),
           _reserved(0) {}
 };
 
 
-class formatter {
-      public:
-        explicit formatter(const format_options& opt) : opt_(opt) {}
+namespace detail {
 
-        // produce the final string for a central value and a list of errors
-        std::string format(const number& central,
-                           const std::vector<number>& errors) const
-        {
-                std::string out;
-                out.reserve(128); // single allocation, should work for most cases
+// symbol table
+template <typename Char>
+struct symbol_table {
+        // mult, mult alternate, plus/minus, parenthesis open/close,
+        // curly open/close, curly pre-space, text open/close, percent
+        std::basic_string_view<Char> x, xa, pm, po, pc, co, cc, cs, to, tc, pt;
+};
 
-                // leading parenthesis for factorised power (if any)
-                if (opt_.factorize_powers && central.p != 0) out += symbols().po;
+// the symbols as code points, one table per display mode, then `ascii`
+// (index 4) that replaces x, xa and pm when utf8 characters are not wanted
+// (its other fields are unused)
+inline constexpr std::array<symbol_table<char32_t>, 5> symbol_points{{
+    {U"×",         U"·",        U"±",            U"(",        U")",         U"",  U"",  U"",          U"",        U"",    U"%"},   // terminal
+    {U" \\times ", U"\\cdot",   U"\\pm",         U"\\left( ", U" \\right)", U"{", U"}", U"\\,",       U"\\text{", U"}",   U"\\%"},  // TeX
+    {U" times ",   U" dot.op ", U" plus.minus ", U"(",        U")",         U"(", U")", U"#h(0.0em)", U"\"",      U"\"",  U"%"}, // typst
+    {U"×",         U"· ",       U"±",            U"(",        U")",         U"{", U"}", U"",          U"",        U"",    U"%"},   // gnuplot
+    {U"x",         U".",        U"+/-",          U"",         U"",          U"",  U"",  U"",          U"",        U"",    U""}     // ascii
+}};
+
+template <typename Char>
+constexpr auto symbol_fields()
+{
+        using T = symbol_table<Char>;
+        return std::array{&T::x, &T::xa, &T::pm, &T::po, &T::pc, &T::co, &T::cc, &T::cs, &T::to, &T::tc, &T::pt};
+}
 
-                // central value
-                out += central.to_string(opt_.factorize_powers);
+// code units of `c` in UTF-8 (char), UTF-16 (char16_t) or UTF-32 (char32_t)
+template <typename Char>
+constexpr std::size_t code_units(char32_t c)
+{
+        if constexpr (sizeof(Char) == 1) return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+        else if constexpr (sizeof(Char) == 2) return c < 0x10000 ? 1 : 2;
+        else return 1;
+}
 
-                // errors
-                size_t cnt_label = 0;
-                for (const auto& e : errors) {
-                        out += ' ';
-                        if (e.sgn != 0 && (opt_.mode == mode_type::gnuplot || opt_.mode == mode_type::tex || opt_.mode == mode_type::typst)) {
-                                if (cnt_label % 2 == 0) out += symbols().cs; // insert a small space before super/subscripts
-                                out += e.sgn == 1 ? '^' : '_'; // sgn discriminates upper/lower errors
-                                out += symbols().co;
-                        }
-                        if (e.sgn == 0) { // the “±” token
-                                out += symbols().pm;
-                                out += ' ';
-                                ++cnt_label; // to increment by 2 for symmetric errors
-                        } else if (e.sgn == 1) {
-                                out += '+'; // explicit + for errors
-                        }
-                        out += e.to_string(opt_.factorize_powers);
-                        if (e.sgn != 0 && (opt_.mode == mode_type::gnuplot || opt_.mode == mode_type::tex || opt_.mode == mode_type::typst)) {
-                                out += symbols().cc;
-                        }
-                        ++cnt_label;
-                        // if provided, add labels
-                        if (opt_.labels && opt_.labels->size() && cnt_label % 2 == 0) {
-                                out += ' ';
-                                out += symbols().to;
-                                out += (*opt_.labels)[cnt_label / 2 - 1];
-                                out += symbols().tc;
-                        }
+// write the code units of `c` at `out`, return the end
+template <typename Char>
+constexpr Char* encode(char32_t c, Char* out)
+{
+        if constexpr (sizeof(Char) == 1) {
+                const std::size_t len = code_units<Char>(c);
+                if (len == 1) {
+                        *out++ = static_cast<Char>(c);
+                        return out;
                 }
-
-                // trailing factorised power (if any)
-                if (opt_.factorize_powers && central.p != 0) {
-                        out += symbols().pc;
-                        if (opt_.cdot) out += symbols().xa;
-                        else           out += symbols().x;
-                        out += "10";
-                        if (central.p != 1) {
-                                out += '^';
-                                out += symbols().co;
-                                out += std::to_string(central.p);
-                                out += symbols().cc;
-                        }
+                const char32_t lead = len == 2 ? 0xc0 : len == 3 ? 0xe0 : 0xf0;
+                *out++ = static_cast<Char>(lead | (c >> (6 * (len - 1))));
+                for (std::size_t k = len - 1; k-- > 0;) *out++ = static_cast<Char>(0x80 | ((c >> (6 * k)) & 0x3f));
+        } else if constexpr (sizeof(Char) == 2) {
+                if (c >= 0x10000) { // surrogate pair
+                        c -= 0x10000;
+                        *out++ = static_cast<Char>(0xd800 + (c >> 10));
+                        c = 0xdc00 + (c & 0x3ff);
                 }
-                return out;
+                *out++ = static_cast<Char>(c);
+        } else {
+                *out++ = c;
         }
+        return out;
+}
 
-      private:
-        const format_options& opt_;
-
-        // symbol table
-        struct symbol_table {
-                // mult, mult alternate, plus/minus, parenthesis open/close,
-                // curly open/close, curly pre-space, text open/close
-                std::string_view x, xa, pm, po, pc, co, cc, cs, to, tc;
-        };
-        static constexpr std::array<symbol_table, 4> table_{{
-            {"×",         "·",        "±",            "(",        ")",         "",  "",  "",          "",        ""},   // terminal
-            {" \\times ", "\\cdot",   "\\pm",         "\\left( ", " \\right)", "{", "}", "\\,",       "\\text{", "}"},  // TeX
-            {" times ",   " dot.op ", " plus.minus ", "(",        ")",         "(", ")", "#h(0.0em)", "\"",      "\""}, // typst
-            {"×",         "· ",       "±",            "(",        ")",         "{", "}", "",          "",        ""}    // gnuplot
-        }};
+template <typename Char>
+constexpr std::size_t symbol_text_size()
+{
+        std::size_t n = 0;
+        for (const auto& t : symbol_points)
+                for (auto f : symbol_fields<char32_t>())
+                        for (char32_t c : t.*f) n += code_units<Char>(c);
+        return n;
+}
 
+// all the symbols encoded one after the other
+template <typename Char>
+constexpr auto encode_symbols()
+{
+        std::array<Char, symbol_text_size<Char>()> text{};
+        Char* out = text.data();
+        for (const auto& t : symbol_points)
+                for (auto f : symbol_fields<char32_t>())
+                        for (char32_t c : t.*f) out = encode(c, out);
+        return text;
+}
 
-        const symbol_table& symbols() const
-        {
-                const symbol_table* base = &table_[static_cast<std::size_t>(opt_.mode)];
-                if (!opt_.no_utf8) return *base;
-                static const symbol_table ascii{"x", ".", "+/-", base->po, base->pc, base->co, base->cc, base->cs, base->to, base->tc};
-                return ascii;
+// the tables of views into `text`, as encoded by encode_symbols
+template <typename Char, std::size_t N>
+constexpr auto symbol_views(const std::array<Char, N>& text)
+{
+        std::array<symbol_table<Char>, symbol_points.size()> r{};
+        const auto src = symbol_fields<char32_t>();
+        const auto dst = symbol_fields<Char>();
+        const Char* at = text.data();
+        for (std::size_t m = 0; m < r.size(); ++m) {
+                for (std::size_t k = 0; k < src.size(); ++k) {
+                        std::size_t len = 0;
+                        for (char32_t c : symbol_points[m].*src[k]) len += code_units<Char>(c);
+                        r[m].*dst[k] = std::basic_string_view<Char>(at, len);
+                        at += len;
+                }
         }
+        return r;
+}
+
+// one table per encoding (UTF-8, UTF-16, UTF-32) and display mode,
+// generated at compile time from `symbol_points`
+template <typename Char>
+struct symbols {
+        static constexpr auto text  = encode_symbols<Char>();
+        static constexpr auto table = symbol_views<Char>(text);
+        static constexpr const symbol_table<Char>& ascii = table[4];
 };
 
 
-namespace detail {
+// append ASCII text (digits, signs) to a string of any encoding
+template <typename Char>
+inline void append_ascii(std::basic_string<Char>& out, std::string_view s)
+{
+        if constexpr (std::is_same_v<Char, char>) out += s;
+        else out.append(s.begin(), s.end());
+}
 
-// symmetrize asymmetric errors if they differ by less than threshold % (default to 10%)
-inline void symmetrize_errors(std::vector<number>& errors, double threshold = 0.1)
+
+// append UTF-8 text (labels) to a string of any encoding
+template <typename Char>
+inline void append_utf8(std::basic_string<Char>& out, std::string_view s)
 {
-        for (int i = static_cast<int>(errors.size()) - 1; i > 0; --i) {
-                auto &ne1 = errors[i];
-                if (ne1.sgn != 0 && i > 0) --i;
-                else continue;
-                auto &ne2 = errors[i];
-                if (ne2.sgn == 0) {
-                        fmt::println("# warning: asymmetric errors do not seem to come in pairs");
-                }
-                double e1 = fabs(ne1.to_double());
-                double e2 = fabs(ne2.to_double());
-                if (fabs(e1 / e2 - 1.) < threshold) {
-                        ne2 = number::from_numeric(0.5 * (e1 + e2));
-                        errors.erase(errors.begin() + i + 1);
+        if constexpr (std::is_same_v<Char, char>) {
+                out += s;
+        } else {
+                for (std::size_t i = 0; i < s.size();) {
+                        auto c = static_cast<unsigned char>(s[i]);
+                        int len = c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+                        char32_t cp = len == 1 ? c : len == 2 ? c & 0x1f : len == 3 ? c & 0x0f : c & 0x07;
+                        for (int k = 1; k < len && i + k < s.size(); ++k)
+                                cp = (cp << 6) | (static_cast<unsigned char>(s[i + k]) & 0x3f);
+                        i += len;
+                        if constexpr (std::is_same_v<Char, char16_t>) {
+                                if (cp >= 0x10000) { // surrogate pair
+                                        cp -= 0x10000;
+                                        out += static_cast<char16_t>(0xd800 + (cp >> 10));
+                                        cp = 0xdc00 + (cp & 0x3ff);
+                                }
+                        }
+                        out += static_cast<Char>(cp);
                 }
         }
 }
 
+} // namespace detail
 
-// perform the rounding
-inline void round(number& central, std::vector<number>& errors, const format_options& opt)
-{
-        if (opt.symmetrize_errors) symmetrize_errors(errors);
-        bool quiet = !(opt.mode == mode_type::terminal && opt.factorize_powers);
-        int prec   = INT_MAX;
 
-        number tote;
-        if (opt.prec == format_options::prec_algo::total_error) {
-                tote = detail::quadrature_sum(errors);
-                if (opt.round == format_options::round_algo::pdg) detail::pdg_round(tote, quiet);
-                else detail::twodig_round(tote, quiet);
-                prec = tote.p;
+// The structure of the errors shared by a batch of measurements, computed
+// once from the signs of a row: which errors are symmetric, upper or lower,
+// whether the asymmetric ones come in pairs and after which errors a label
+// goes. Rows with the same signs are then formatted (and their errors summed)
+// without rediscovering it.
+class error_schema {
+      public:
+        // what the formatter emits around error `j`
+        struct entry {
+                std::int8_t sgn;    // 0: “±”, +1/-1: upper/lower
+                bool space;         // small space before a super/subscript
+                std::int32_t label; // index of the label that follows, or -1
+        };
+
+        error_schema() = default;
+        explicit error_schema(std::span<const number> errors)
+        {
+                entries_.reserve(errors.size());
+                std::int32_t label = 0;
+                paired_ = detail::for_each_element(errors, [&](std::size_t j, const auto& e) {
+                        emit(e, label++, errors.subspan(j), [this](const number&, const entry& k) { entries_.push_back(k); });
+                }) == 0;
         }
 
-        if (opt.prec == format_options::prec_algo::largest_error) {
-                // match the precision of the central value to that of the less precise error
-                prec = INT_MIN;
-                if (opt.round == format_options::round_algo::pdg) {
-                        for (auto &e : errors)
-                                detail::pdg_round(e, quiet);
+        std::size_t size() const noexcept { return entries_.size(); }
+        const entry& operator[](std::size_t j) const noexcept { return entries_[j]; }
+
+        // the asymmetric errors come in adjacent pairs
+        bool paired() const noexcept { return paired_; }
+
+        // `errors` has the structure described by the schema
+        bool matches(std::span<const number> errors) const noexcept
+        {
+                if (errors.size() != entries_.size()) return false;
+                for (std::size_t j = 0; j < errors.size(); ++j)
+                        if (errors[j].sgn != entries_[j].sgn) return false;
+                return true;
+        }
+
+        // call `f(n, k)` for each number `n` of the element `e` followed by
+        // `label`, with its entry `k`: used row by row without a schema.
+        // For a row of adjacent `number`s, `at` holds them from the element
+        // on, whose signs and order are kept; for a row of elements it is
+        // empty, and a `number` is a symmetric error
+        static void emit(const number& e, std::int32_t label, std::span<const number> at, auto&& f)
+        {
+                const std::int8_t sgn = at.empty() ? 0 : static_cast<std::int8_t>(e.sgn);
+                f(e, entry{sgn, sgn != 0, label});
+        }
+        static void emit(const asym_error& e, std::int32_t label, std::span<const number> at, auto&& f)
+        {
+                if (at.empty()) {
+                        f(e.up, entry{+1, true, -1});
+                        f(e.down, entry{-1, false, label});
                 } else {
-                        for (auto &e : errors)
-                                detail::twodig_round(e, quiet);
+                        f(at[0], entry{static_cast<std::int8_t>(at[0].sgn), true, -1});
+                        f(at[1], entry{static_cast<std::int8_t>(at[1].sgn), false, label});
                 }
-                for (auto &e : errors) prec = std::max(prec, e.p);
         }
 
-        // round everything else to match the precision
-        if (prec != INT_MAX) {
-                detail::round_to_prec(central, prec);
-                for (auto &e : errors) detail::round_to_prec(e, prec);
-        } else if (opt.round == format_options::round_algo::pdg) {
-                // or round independently to the chosen algorithms
-                detail::pdg_round(central, quiet);
-                for (auto &e : errors) detail::pdg_round(e, quiet);
-        } else {
-                // or round independently to the chosen algorithms
-                detail::twodig_round(central, quiet);
-                for (auto &e : errors) detail::twodig_round(e, quiet);
-        }
-}
-} // namespace detail
-} // namespace rounder
+      private:
+        std::vector<entry> entries_;
+        bool paired_ = true;
+};
+
+
+class formatter {
+      public:
+        explicit formatter(const format_options& opt) : opt_(opt) {}
+
+        // produce the final string for a central value and a list of errors
+        std::string format(const number& central,
+                           std::span<const number> errors) const
+        {
+                return format_as<char>(central, errors);
+        }
+
+        // as above, for errors paired by their structure
+        std::string format_elements(const number& central, std::span<const error_element> errors) const
+        {
+                std::string out;
+                out.reserve(128);
+                format_elements_to(out, central, errors);
+                return out;
+        }
+
+        // as above, in UTF-8 (char), UTF-16 (char16_t) or UTF-32 (char32_t)
+        template <typename Char>
+        std::basic_string<Char> format_as(const number& central,
+                                          std::span<const number> errors) const
+        {
+                std::basic_string<Char> out;
+                out.reserve(128); // single allocation, should work for most cases
+                format_to(out, central, errors);
+                return out;
+        }
+
+        // append the final string to `out` (defined below the class, not
+        // inline, so that the extern templates skip its code)
+        template <typename Char>
+        void format_to(std::basic_string<Char>& out, const number& central,
+                       std::span<const number> errors) const;
+
+        // as above, for errors with the structure of `schema` (see
+        // error_schema::matches), which is not rediscovered
+        template <typename Char>
+        void format_to(std::basic_string<Char>& out, const number& central,
+                       std::span<const number> errors, const error_schema& schema) const
+        {
+                write(out, central, !errors.empty(), [&errors, &schema](auto&& emit) {
+                        for (std::size_t j = 0; j < errors.size(); ++j) emit(errors[j], schema[j]);
+                });
+        }
+
+        // as above, for errors paired by their structure: one label per element
+        template <typename Char>
+        void format_elements_to(std::basic_string<Char>& out, const number& central,
+                                std::span<const error_element> errors) const
+        {
+                write(out, central, !errors.empty(), [&errors](auto&& emit) {
+                        std::int32_t label = 0;
+                        for (const auto& e : errors)
+                                std::visit([&](const auto& v) { error_schema::emit(v, label++, {}, emit); }, e);
+                });
+        }
+
+      private:
+        const format_options& opt_;
+
+        // `errors(emit)` calls `emit(e, k)` for each error `e` in order,
+        // `k` being its error_schema::entry
+        template <typename Char, typename Errors>
+        void write(std::basic_string<Char>& out, const number& central,
+                   bool has_errors, Errors&& errors) const
+        {
+                const detail::symbol_table<Char> sym = symbols<Char>();
+                const bool script = opt_.mode == mode_type::gnuplot || opt_.mode == mode_type::tex || opt_.mode == mode_type::typst;
+                const std::size_t n_labels = opt_.labels ? opt_.labels->size() : 0;
+
+                // leading parenthesis for factorised power (if any), not needed
+                // for a number alone
+                const bool parens = opt_.factorize_powers && central.p != 0 && has_errors;
+                if (parens) out += sym.po;
+
+                // central value
+                detail::append_ascii(out, central.to_string(opt_.factorize_powers));
+
+                // errors
+                errors([&](const number& e, const error_schema::entry& k) {
+                        out += ' ';
+                        if (k.sgn != 0 && script) {
+                                if (k.space) out += sym.cs; // insert a small space before super/subscripts
+                                out += k.sgn == 1 ? '^' : '_'; // sgn discriminates upper/lower errors
+                                out += sym.co;
+                        }
+                        if (k.sgn == 0) { // the “±” token
+                                out += sym.pm;
+                                out += ' ';
+                        } else if (k.sgn == 1) {
+                                out += '+'; // explicit + for errors
+                        }
+                        if (opt_.percent_errors) {
+                                detail::append_ascii(out, detail::percent_of(e, central).to_string());
+                                out += sym.pt;
+                        } else {
+                                detail::append_ascii(out, e.to_string(opt_.factorize_powers));
+                        }
+                        if (k.sgn != 0 && script) out += sym.cc;
+                        // if provided, add labels
+                        if (k.label >= 0 && static_cast<std::size_t>(k.label) < n_labels) {
+                                out += ' ';
+                                out += sym.to;
+                                detail::append_utf8(out, (*opt_.labels)[k.label]);
+                                out += sym.tc;
+                        }
+                });
+
+                // trailing factorised power (if any)
+                if (opt_.factorize_powers && central.p != 0) {
+                        if (parens) out += sym.pc;
+                        if (opt_.cdot) out += sym.xa;
+                        else           out += sym.x;
+                        detail::append_ascii(out, "10");
+                        if (central.p != 1) {
+                                out += '^';
+                                out += sym.co;
+                                detail::append_ascii(out, std::to_string(central.p));
+                                out += sym.cc;
+                        }
+                }
+        }
+
+        template <typename Char>
+        detail::symbol_table<Char> symbols() const
+        {
+                detail::symbol_table<Char> sym = detail::symbols<Char>::table[static_cast<std::size_t>(opt_.mode)];
+                if (opt_.no_utf8) {
+                        sym.x  = detail::symbols<Char>::ascii.x;
+                        sym.xa = detail::symbols<Char>::ascii.xa;
+                        sym.pm = detail::symbols<Char>::ascii.pm;
+                }
+                return sym;
+        }
+};
+
+
+template <typename Char>
+void formatter::format_to(std::basic_string<Char>& out, const number& central,
+                          std::span<const number> errors) const
+{
+        write(out, central, !errors.empty(), [&errors](auto&& emit) {
+                std::int32_t label = 0;
+                detail::for_each_element(errors, [&](std::size_t j, const auto& e) {
+                        error_schema::emit(e, label++, errors.subspan(j), emit);
+                });
+        });
+}
+
+
+#ifdef ROUNDLIB_TEMPLATE
+ROUNDLIB_TEMPLATE void formatter::format_to(std::string&, const number&, std::span<const number>) const;
+ROUNDLIB_TEMPLATE void formatter::format_to(std::u16string&, const number&, std::span<const number>) const;
+ROUNDLIB_TEMPLATE void formatter::format_to(std::u32string&, const number&, std::span<const number>) const;
+#endif
+
+
+/*-------------------
+ * rounding policies
+ *-------------------*/
+// A rounding policy rounds in place a single number (an error, or the total
+// error) with a static `round(number&, bool quiet)`; `quiet` silences the
+// warnings. Policies are template arguments, their calls are inlined as
+// for the built-in algorithms. An optional `round(std::span<number>, bool)`
+// rounds all the errors at once. The central value and the other errors
+// are then rounded to the resulting precision half up, or with the rule
+// of an optional `static constexpr tie_rule ties`.
+template <typename P>
+concept rounding_policy = requires(number& n, bool quiet) {
+        { P::round(n, quiet) } -> std::same_as<void>;
+};
+
+
+namespace detail {
+
+template <rounding_policy P>
+constexpr tie_rule ties_of()
+{
+        if constexpr (requires { { P::ties } -> std::convertible_to<tie_rule>; }) return P::ties;
+        else return tie_rule::half_up;
+}
+
+} // namespace detail
+
+
+// PDG algorithm (built-in, `round_algo::pdg`)
+struct pdg_policy {
+        static void round(number& n, bool quiet) { detail::pdg_round(n, quiet); }
+};
+
+
+// two significant digits (built-in, `round_algo::twodigits`)
+struct twodigits_policy {
+        static void round(number& n, bool quiet) { detail::twodig_round(n, quiet); }
+};
+
+
+// PDG-like algorithm with custom thresholds on the three-digit mantissa,
+// e.g. for journal-specific rules: up to `Two` keep two digits,
+// up to `One` keep one digit, above round up to 1000
+template <std::uint64_t Two, std::uint64_t One>
+struct threshold_policy {
+        static_assert(100 <= Two && Two <= One && One <= 999, "thresholds must be ordered three-digit numbers");
+        static void round(number& n, bool quiet)
+        {
+                detail::keep_three_sig(n, quiet);
+                detail::apply_rule(n, detail::pdg_table<Two, One>);
+        }
+};
+
+
+// N significant digits, ties rounded up
+template <int N>
+struct sig_digits_policy {
+        static_assert(N > 0 && N < 19, "the number of digits must fit in the mantissa");
+        static void round(number& n, bool quiet)
+        {
+                detail::keep_sig_digits(n, N + 1, quiet);
+                int u = n.n % 10;
+                n.n /= 10;
+                if (u >= 5) ++n.n;
+                ++n.p;
+        }
+};
+
+
+// N significant digits, ties rounded to even (also for the central value
+// and the other errors rounded to the same precision)
+template <int N>
+struct half_even_policy {
+        static_assert(N > 0 && N < 19, "the number of digits must fit in the mantissa");
+        static constexpr tie_rule ties = tie_rule::half_even;
+        static void round(number& n, bool quiet)
+        {
+                int nd = detail::digit_count(n.n);
+                if (nd <= N) {
+                        detail::keep_sig_digits(n, N, quiet);
+                        return;
+                }
+                std::uint64_t div = 1;
+                for (int i = N; i < nd; ++i) div *= 10;
+                std::uint64_t q = n.n / div;
+                std::uint64_t r = n.n % div;
+                if (r > div / 2 || (r == div / 2 && q % 2 == 1)) ++q;
+                n.n = q;
+                n.p += nd - N;
+        }
+};
+
+
+template <format_options::round_algo A>
+using builtin_policy = std::conditional_t<A == format_options::round_algo::pdg, pdg_policy, twodigits_policy>;
+
+
+namespace detail {
+
+// the symmetric error replacing an asymmetric pair whose errors differ by
+// less than `threshold` (10% by default), if they do
+inline std::optional<number> symmetrized(const asym_error& e, double threshold = 0.1)
+{
+        double e1 = fabs(e.down.to_double());
+        double e2 = fabs(e.up.to_double());
+        if (fabs(e1 / e2 - 1.) < threshold) return number::from_numeric(0.5 * (e1 + e2));
+        return std::nullopt;
+}
+
+
+// symmetrize in place errors paired by their structure: a merged pair
+// becomes a symmetric error, nothing is shifted
+inline void symmetrize_errors(std::span<error_element> errors, double threshold = 0.1)
+{
+        for (auto& e : errors) {
+                std::visit([&e, threshold](const auto& v) {
+                        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, asym_error>) {
+                                if (auto m = symmetrized(v, threshold)) e = *m;
+                        }
+                }, e);
+        }
+}
+
+
+// as above, for adjacent `number`s: the merged errors are removed by
+// shifting the following ones, return the new size
+inline std::size_t symmetrize_errors(std::span<number> errors, double threshold = 0.1)
+{
+        std::size_t size = 0;
+        auto merge = [&](std::size_t j, const auto& e) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(e)>, asym_error>) {
+                        if (auto m = symmetrized(e, threshold)) {
+                                errors[size++] = *m;
+                        } else {
+                                errors[size++] = errors[j];
+                                errors[size++] = errors[j + 1];
+                        }
+                } else {
+                        errors[size++] = e;
+                }
+        };
+        if (for_each_element(errors, merge) != 0) warn_unpaired();
+        return size;
+}
+
+
+inline void symmetrize_errors(std::vector<number>& errors, double threshold = 0.1)
+{
+        errors.resize(symmetrize_errors(std::span<number>(errors), threshold));
+}
+
+
+// the warnings are printed in terminal mode with factorized powers only
+constexpr bool quiet_rounding(const format_options& opt)
+{
+        return !(opt.mode == mode_type::terminal && opt.factorize_powers);
+}
+
+
+// perform the rounding in place with the policy `P`, return the number
+// of errors left (asymmetric errors merged by the symmetrization are removed):
+// the precision algorithm of `Opt` is resolved by `if constexpr`, the
+// warnings are silenced by `quiet` (quiet_rounding); not inline, so that
+// the extern templates skip its code
+template <rounding_policy P, format_options Opt>
+std::size_t round_with(number& central, std::span<number> errors, bool quiet)
+{
+        if constexpr (Opt.symmetrize_errors) errors = errors.first(symmetrize_errors(errors));
+
+        int prec;
+        if constexpr (Opt.prec == format_options::prec_algo::total_error) {
+                number tote = detail::quadrature_sum(errors);
+                P::round(tote, quiet);
+                prec = tote.p;
+        } else {
+                // match the precision of the central value to that of the less precise error
+                prec = INT_MIN;
+                for (auto &e : errors) {
+                        P::round(e, quiet);
+                        prec = std::max(prec, e.p);
+                }
+        }
+
+        // round everything else to match the precision
+        constexpr tie_rule ties = ties_of<P>();
+        detail::round_to_prec<ties>(central, prec);
+        for (auto &e : errors) detail::round_to_prec<ties>(e, prec);
+        return errors.size();
+}
+
+
+// as above, with the built-in policy selected by `Opt.round`
+template <format_options Opt>
+inline std::size_t round(number& central, std::span<number> errors)
+{
+        return round_with<builtin_policy<Opt.round>, Opt>(central, errors, quiet_rounding(Opt));
+}
+
+
+// only the precision and rounding algorithms select an instantiation: the
+// symmetrization is done before the dispatch and the warnings are a runtime
+// argument, not to multiply their number
+constexpr unsigned rounding_key(const format_options& opt)
+{
+        return (opt.prec == format_options::prec_algo::total_error ? 1u : 0u)
+               | (opt.round == format_options::round_algo::twodigits ? 2u : 0u);
+}
+
+
+constexpr format_options rounding_options(unsigned key)
+{
+        format_options opt;
+        opt.prec  = (key & 1u) ? format_options::prec_algo::total_error : format_options::prec_algo::largest_error;
+        opt.round = (key & 2u) ? format_options::round_algo::twodigits : format_options::round_algo::pdg;
+        return opt;
+}
+
+
+template <unsigned K>
+using builtin_policy_of = builtin_policy<rounding_options(K).round>;
+
+
+#ifdef ROUNDLIB_TEMPLATE
+// the instantiations of the runtime dispatch below
+#define ROUNDLIB_ROUND(K) \
+        ROUNDLIB_TEMPLATE std::size_t round_with<builtin_policy_of<K>, rounding_options(K)>(number&, std::span<number>, bool);
+ROUNDLIB_ROUND(0) ROUNDLIB_ROUND(1) ROUNDLIB_ROUND(2) ROUNDLIB_ROUND(3)
+#undef ROUNDLIB_ROUND
+#endif
+
+
+using round_fn = std::size_t (*)(number&, std::span<number>, bool);
+
+template <std::size_t... K>
+constexpr auto make_round_table(std::index_sequence<K...>)
+{
+        return std::array<round_fn, sizeof...(K)>{&round_with<builtin_policy_of<K>, rounding_options(K)>...};
+}
+
+
+// a user policy replaces the rounding algorithm: `format_options::round` is ignored
+template <rounding_policy P, std::size_t... K>
+constexpr auto make_round_table(std::index_sequence<K...>)
+{
+        return std::array<round_fn, sizeof...(K)>{&round_with<P, rounding_options(K)>...};
+}
+
+
+// runtime options: dispatch to the matching instantiation
+inline std::size_t round(number& central, std::span<number> errors, const format_options& opt)
+{
+        static constexpr auto table = make_round_table(std::make_index_sequence<4>{});
+        if (opt.symmetrize_errors) errors = errors.first(symmetrize_errors(errors));
+        return table[rounding_key(opt)](central, errors, quiet_rounding(opt));
+}
+
+
+template <rounding_policy P>
+inline std::size_t round(number& central, std::span<number> errors, const format_options& opt)
+{
+        static constexpr auto table = make_round_table<P>(std::make_index_sequence<2>{});
+        if (opt.symmetrize_errors) errors = errors.first(symmetrize_errors(errors));
+        return table[rounding_key(opt) & 1u](central, errors, quiet_rounding(opt));
+}
+
+
+// round in place errors paired by their structure, with the policy `P`:
+// nothing is inferred, a merged pair becomes a symmetric error in place and
+// the total error sums both squares of each pair
+template <rounding_policy P>
+inline void round_elements_with(number& central, std::span<error_element> errors, const format_options& opt)
+{
+        const bool quiet = quiet_rounding(opt);
+        if (opt.symmetrize_errors) symmetrize_errors(errors);
+        auto each = [&errors](auto&& f) {
+                for (auto& e : errors) {
+                        std::visit([&f](auto& v) {
+                                if constexpr (std::is_same_v<std::decay_t<decltype(v)>, asym_error>) {
+                                        f(v.up);
+                                        f(v.down);
+                                } else {
+                                        f(v);
+                                }
+                        }, e);
+                }
+        };
+
+        int prec = INT_MIN;
+        if (opt.prec == format_options::prec_algo::total_error) {
+                number tote = quadrature_sum(std::span<const error_element>(errors));
+                P::round(tote, quiet);
+                prec = tote.p;
+        } else {
+                each([&](number& e) {
+                        P::round(e, quiet);
+                        prec = std::max(prec, e.p);
+                });
+        }
+
+        constexpr tie_rule ties = ties_of<P>();
+        round_to_prec<ties>(central, prec);
+        each([prec](number& e) { round_to_prec<ties>(e, prec); });
+}
+
+
+// as above, with the built-in policy selected by `opt.round`
+inline void round_elements(number& central, std::span<error_element> errors, const format_options& opt)
+{
+        if (opt.round == format_options::round_algo::twodigits) round_elements_with<twodigits_policy>(central, errors, opt);
+        else                                                     round_elements_with<pdg_policy>(central, errors, opt);
+}
+
+
+// the two runtime flavours as function objects, to be passed to generic code
+struct builtin_rounder {
+        std::size_t operator()(number& central, std::span<number> errors, const format_options& opt) const
+        {
+                return round(central, errors, opt);
+        }
+        void operator()(number& central, std::span<error_element> errors, const format_options& opt) const
+        {
+                round_elements(central, errors, opt);
+        }
+};
+
+
+template <rounding_policy P>
+struct policy_rounder {
+        std::size_t operator()(number& central, std::span<number> errors, const format_options& opt) const
+        {
+                return round<P>(central, errors, opt);
+        }
+        void operator()(number& central, std::span<error_element> errors, const format_options& opt) const
+        {
+                round_elements_with<P>(central, errors, opt);
+        }
+};
+
+
+inline void round(number& central, std::vector<number>& errors, const format_options& opt)
+{
+        errors.resize(round(central, std::span<number>(errors), opt));
+}
+} // namespace detail
+} // namespace rounder
 
 
 /*-----
@@ -597,6 +1519,43 @@ inline void round(number& central, std::vector<number>& errors, const format_opt
  *-----*/
 namespace rounder {
 
+namespace detail {
+
+// round a copy of the errors with `round` (same signature as `detail::round`)
+// in a stack buffer, or in a heap copy if they are too many, then format
+template <typename Char = char, typename Round>
+inline std::basic_string<Char> format_copy(number value, std::span<const number> errors,
+                                           const format_options& opt, Round&& round)
+{
+        constexpr std::size_t stack_errors = 16;
+        std::array<number, stack_errors> buf;
+        std::vector<number> heap;
+        std::span<number> e;
+        if (errors.size() > stack_errors) {
+                heap.assign(errors.begin(), errors.end());
+                e = heap;
+        } else {
+                e = std::span<number>(buf.data(), errors.size());
+                std::copy(errors.begin(), errors.end(), e.begin());
+        }
+        e = e.first(round(value, e, opt));
+        formatter fmt(opt);
+        return fmt.format_as<Char>(value, e);
+}
+
+// round in place the errors in `scratch` and append the text to `out`:
+// no allocation once both have grown to their working size
+inline void format_append(std::string& out, number value, std::vector<number>& scratch,
+                          const format_options& opt)
+{
+        detail::round(value, scratch, opt);
+        formatter fmt(opt);
+        fmt.format_to(out, value, scratch);
+}
+
+} // namespace detail
+
+
 // value + multiple errors (signed +/- for upper/lower, unsigned for symmetric)
 inline std::string format_numbers(number value, std::vector<number>& errors,
                           const format_options& opt = {})
@@ -607,10 +1566,98 @@ inline std::string format_numbers(number value, std::vector<number>& errors,
 }
 
 
+// as above, rounding in the storage of a temporary vector
+inline std::string format_numbers(number value, std::vector<number>&& errors,
+                          const format_options& opt = {})
+{
+        return format_numbers(value, errors, opt);
+}
+
+
+// as above, leaving the input untouched: the errors are rounded
+// in a stack buffer (or in a heap copy if they are too many)
+inline std::string format_numbers(number value, std::span<const number> errors,
+                          const format_options& opt = {})
+{
+        return detail::format_copy(value, errors, opt, detail::builtin_rounder{});
+}
+
+
+// value + errors paired by their structure (`number` or `asym_error`),
+// rounded and formatted without inferring the pairs (unlike format_numbers)
+inline std::string format_elements(number value, std::vector<error_element>& errors,
+                                   const format_options& opt = {})
+{
+        detail::round_elements(value, errors, opt);
+        formatter fmt(opt);
+        return fmt.format_elements(value, errors);
+}
+
+
+// as above, leaving the input untouched: the elements are rounded
+// in a stack buffer (or in a heap copy if they are too many)
+inline std::string format_elements(number value, std::span<const error_element> errors,
+                                   const format_options& opt = {})
+{
+        constexpr std::size_t stack_errors = 8;
+        std::array<error_element, stack_errors> buf;
+        std::vector<error_element> heap;
+        std::span<error_element> e;
+        if (errors.size() > stack_errors) {
+                heap.assign(errors.begin(), errors.end());
+                e = heap;
+        } else {
+                e = std::span<error_element>(buf.data(), errors.size());
+                std::copy(errors.begin(), errors.end(), e.begin());
+        }
+        detail::round_elements(value, e, opt);
+        formatter fmt(opt);
+        return fmt.format_elements(value, e);
+}
+
+
+// as above, the output is UTF-8 (char), UTF-16 (char16_t) or UTF-32 (char32_t)
+// text written directly, e.g. for toolkits working in UTF-16
+template <typename Char>
+inline std::basic_string<Char> format_numbers_as(number value, std::span<const number> errors,
+                                                 const format_options& opt = {})
+{
+        return detail::format_copy<Char>(value, errors, opt, detail::builtin_rounder{});
+}
+
+
+// the same three flavours, rounding with the policy `P` instead of `opt.round`
+template <rounding_policy P>
+inline std::string format_numbers(number value, std::vector<number>& errors,
+                          const format_options& opt = {})
+{
+        errors.resize(detail::round<P>(value, std::span<number>(errors), opt));
+        formatter fmt(opt);
+        return fmt.format(value, errors);
+}
+
+
+template <rounding_policy P>
+inline std::string format_numbers(number value, std::vector<number>&& errors,
+                          const format_options& opt = {})
+{
+        return format_numbers<P>(value, errors, opt);
+}
+
+
+template <rounding_policy P>
+inline std::string format_numbers(number value, std::span<const number> errors,
+                          const format_options& opt = {})
+{
+        return detail::format_copy(value, errors, opt, detail::policy_rounder<P>{});
+}
+
+
 // format with rounding the following inputs:
 // - value, single error
 // - value, container of errors
-// where value and error(s) can be anything convertible to arithmetic types or to string_view 
+// where value and error(s) can be anything convertible to arithmetic types or to string_view
+// (errors as text can be relative to the value, e.g. `5%` or `r0.05`)
 template<typename V, typename E>
 inline std::string format(const V& val, const E& err,
                           const format_options &opt = {})
@@ -619,12 +1666,56 @@ inline std::string format(const V& val, const E& err,
         std::vector<number> e;
         if constexpr (detail::is_container_v<E>) {
                 e.reserve(err.size());
-                for (const auto& el : err) e.emplace_back(number::from_anything(el));
+                for (const auto& el : err) e.emplace_back(detail::error_from_anything(el, v));
         } else {
                 e.reserve(1);
-                e.emplace_back(number::from_anything(err));
+                e.emplace_back(detail::error_from_anything(err, v));
         }
-        return format_numbers(v, e, opt);
+        return format_numbers(v, std::move(e), opt);
+}
+
+
+namespace detail {
+
+inline void check_sig_digits(int digits)
+{
+        if (digits < 1 || digits > 19) {
+                detail::fail("# error: cannot keep {} significant digits", digits);
+        }
+}
+
+} // namespace detail
+
+
+// numbers without uncertainties (yields, luminosities, ...): rounded half up
+// to `digits` significant digits, in place
+inline void round_sig(std::span<number> values, int digits = 3)
+{
+        detail::check_sig_digits(digits);
+        detail::round_sig_digits(values, digits);
+}
+
+
+// as above, formatted with the display options of `opt`
+inline std::string format_sig(number value, int digits = 3, const format_options& opt = {})
+{
+        detail::check_sig_digits(digits);
+        detail::round_sig_digits(value, digits);
+        formatter fmt(opt);
+        return fmt.format(value, {});
+}
+
+
+// as above for many numbers: rounded all at once, then formatted
+inline std::vector<std::string> format_sig(std::span<const number> values, int digits = 3,
+                                           const format_options& opt = {})
+{
+        std::vector<number> v(values.begin(), values.end());
+        round_sig(v, digits);
+        formatter fmt(opt);
+        std::vector<std::string> out(v.size());
+        for (std::size_t i = 0; i < v.size(); ++i) fmt.format_to(out[i], v[i], {});
+        return out;
 }
 } // namespace rounder
 
@@ -642,14 +1733,255 @@ struct measurement {
         std::vector<rounder::number> errors;
         std::vector<std::string_view> labels;
 };
+
+
+// A measurement with its options, rounded and formatted only when the text
+// is first needed (printed with fmt or converted to a string), then cached.
+// The cache is filled lazily from a const object: not thread-safe.
+class formatted_measurement {
+      public:
+        formatted_measurement(measurement m, const format_options& opt = {})
+            : m_(std::move(m)), opt_(opt)
+        {}
+
+        const std::string& str() const
+        {
+                if (!text_) {
+                        format_options o = opt_;
+                        if (!m_.labels.empty()) o.labels = &m_.labels;
+                        text_ = format_numbers(m_.central, std::span<const number>(m_.errors), o);
+                }
+                return *text_;
+        }
+        explicit operator std::string() const { return str(); }
+
+        bool rendered() const noexcept { return text_.has_value(); }
+        const measurement& get() const noexcept { return m_; }
+        const format_options& options() const noexcept { return opt_; }
+
+      private:
+        measurement m_;
+        format_options opt_;
+        mutable std::optional<std::string> text_;
+};
+
+/*-------------------------------------------
+ * incremental parsing of streamed measurements
+ *-------------------------------------------*/
+// Push-style parser of measurements given one per line, the central value
+// followed by the errors (with the syntax of `number::from_string`, or a
+// `number_syntax`, or relative as `5%` or `r0.05`), separated by blanks,
+// commas or semicolons; `#` starts a comment. Chunks of any size are fed
+// as they arrive (from a pipe or a socket): numbers split across chunks are
+// resumed from the scan state, nothing is buffered.
+class measurement_parser {
+      public:
+        // with a `syntax` for decimal commas, the comma is no separator; the
+        // grouping characters are skipped and separate nothing, except the
+        // blanks (and `,` or `;`): these group the integer digits of a number
+        // only when exactly three digits follow them, else they separate
+        explicit measurement_parser(const number_syntax& syntax = {})
+        {
+                cls_.fill(invalid);
+                for (char c = '0'; c <= '9'; ++c) cls_[static_cast<unsigned char>(c)] = digit;
+                for (char c : {' ', '\t', '\r', ',', ';'}) cls_[static_cast<unsigned char>(c)] = blank;
+                cls_['+']  = sign;
+                cls_['-']  = sign;
+                cls_['\n'] = newline;
+                cls_['#']  = comment;
+                cls_['r']  = relative;
+                cls_['%']  = percent;
+                for (char c : syntax.grouping) {
+                        auto& k = cls_[static_cast<unsigned char>(c)];
+                        k = k == blank ? group_blank : skip;
+                }
+                cls_[static_cast<unsigned char>(syntax.decimal)] = dot;
+        }
+
+        // call `f(number& central, std::vector<number>& errors)` for each
+        // complete measurement in `chunk`; `f` may modify both (e.g. round them)
+        template <typename F>
+        void feed(std::string_view chunk, F&& f)
+        {
+                for (char c : chunk) {
+                        const std::uint8_t k = cls_[static_cast<unsigned char>(c)];
+                        if (comment_) {
+                                if (k == newline) {
+                                        comment_ = false;
+                                        end_line(f);
+                                }
+                                continue;
+                        }
+                        if (group_) {
+                                if (k == digit && group_digits_ < 3) {
+                                        group_mant_ = group_mant_ * 10 + static_cast<std::uint64_t>(c - '0');
+                                        ++group_digits_;
+                                        continue;
+                                }
+                                end_group(k != digit && group_digits_ == 3);
+                        }
+                        switch (k) {
+                        case digit:
+                                if (shift_ == 2) error("misplaced percent sign");
+                                add_digit(c - '0');
+                                break;
+                        case dot:
+                                if (dot_) error("multiple decimal points");
+                                dot_      = true;
+                                in_token_ = true;
+                                break;
+                        case relative:
+                                if (digits_ || dot_ || shift_ >= 0) error("misplaced relative marker");
+                                shift_    = 0;
+                                in_token_ = true;
+                                break;
+                        case percent:
+                                if (!digits_ || shift_ >= 0) error("misplaced percent sign");
+                                shift_ = 2;
+                                break;
+                        case sign:
+                                if (in_token_) error("misplaced sign");
+                                sgn_      = c == '+' ? +1 : -1;
+                                in_token_ = true;
+                                break;
+                        case blank:
+                                end_token();
+                                break;
+                        case group_blank: // maybe between groups of digits
+                                if (in_token_ && digits_ && !dot_ && shift_ < 0) {
+                                        group_        = true;
+                                        group_mant_   = 0;
+                                        group_digits_ = 0;
+                                } else {
+                                        end_token();
+                                }
+                                break;
+                        case newline:
+                                end_line(f);
+                                break;
+                        case comment:
+                                end_token();
+                                comment_ = true;
+                                break;
+                        case skip:
+                                break;
+                        default:
+                                error("invalid character");
+                        }
+                }
+        }
+
+        // the end of the input also ends the last line
+        template <typename F>
+        void finish(F&& f)
+        {
+                if (group_) end_group(group_digits_ == 3);
+                comment_ = false;
+                end_line(f);
+        }
+
+        std::size_t line() const noexcept { return line_; }
+
+      private:
+        // character classes
+        enum : std::uint8_t { invalid, digit, dot, sign, blank, group_blank, newline, comment, skip, relative, percent };
+        std::array<std::uint8_t, 256> cls_;
+        // scan state of the current number
+        std::uint64_t mant_ = 0;
+        int frac_           = 0;
+        int sgn_            = 0;
+        int shift_          = -1; // relative error: 0 fraction, 2 percent
+        bool dot_           = false;
+        bool digits_        = false;
+        bool in_token_      = false;
+        bool comment_       = false;
+        // digits after a grouping blank, not yet known to be a group
+        bool group_               = false;
+        int group_digits_         = 0;
+        std::uint64_t group_mant_ = 0;
+        // current measurement
+        bool has_central_ = false;
+        number central_;
+        std::vector<number> errors_;
+        std::size_t line_ = 1;
+
+        [[noreturn]] void error(std::string_view what) const
+        {
+                detail::fail("# error: {} at line {}", what, line_);
+        }
+
+        void add_digit(int d)
+        {
+                if (mant_ > (std::numeric_limits<std::uint64_t>::max() - d) / 10) error("mantissa overflow");
+                mant_ = mant_ * 10 + static_cast<std::uint64_t>(d);
+                frac_ += dot_;
+                digits_   = true;
+                in_token_ = true;
+        }
+
+        // after a grouping blank: a group of three digits continues the
+        // number, else the blank separated it from a number starting with
+        // the digits read since
+        void end_group(bool grouping)
+        {
+                group_ = false;
+                if (grouping) {
+                        if (mant_ > (std::numeric_limits<std::uint64_t>::max() - group_mant_) / 1000) error("mantissa overflow");
+                        mant_ = mant_ * 1000 + group_mant_;
+                        return;
+                }
+                end_token();
+                if (group_digits_ == 0) return;
+                mant_     = group_mant_;
+                digits_   = true;
+                in_token_ = true;
+        }
+
+        void end_token()
+        {
+                if (!in_token_) return;
+                if (!digits_) error("no digits");
+                number n;
+                n.n   = mant_;
+                n.p   = -frac_;
+                n.sgn = sgn_;
+                if (shift_ >= 0) {
+                        if (!has_central_) error("relative central value");
+                        n.p -= shift_;
+                        n = number::from_relative(n, central_);
+                }
+                if (has_central_) errors_.push_back(n);
+                else central_ = n;
+                has_central_ = true;
+                mant_        = 0;
+                frac_ = sgn_ = 0;
+                shift_       = -1;
+                dot_ = digits_ = in_token_ = false;
+        }
+
+        template <typename F>
+        void end_line(F& f)
+        {
+                end_token();
+                if (has_central_) f(central_, errors_);
+                has_central_ = false;
+                errors_.clear();
+                ++line_;
+        }
+};
+
 } // namespace rounder
 
-#include <fmt/core.h>
 #include <string_view>
 
 template <>
 struct fmt::formatter<rounder::measurement> {
-        mutable rounder::format_options opts_{};
+        rounder::format_options opts_{};
+        // fill, alignment and width as for strings, e.g. `{:*>40tF}`
+        char fill_[4]{' '};
+        int fill_size_ = 1;
+        char align_    = '<';
+        std::size_t width_ = 0;
 
         constexpr auto parse(fmt::format_parse_context& ctx) -> decltype(ctx.begin())
         {
@@ -659,6 +1991,23 @@ struct fmt::formatter<rounder::measurement> {
                 // default
                 opts_.round = rounder::format_options::round_algo::pdg;
                 opts_.prec = rounder::format_options::prec_algo::largest_error;
+
+                // [[fill]align][width], the fill is a UTF-8 code point
+                constexpr auto is_align = [](char c) { return c == '<' || c == '>' || c == '^'; };
+                if (i != end && *i != '}') {
+                        const unsigned char b = static_cast<unsigned char>(*i);
+                        const int len = b < 0x80 ? 1 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+                        if (end - i > len && is_align(i[len])) {
+                                for (int k = 0; k < len; ++k) fill_[k] = i[k];
+                                fill_size_ = len;
+                                i += len;
+                                align_ = *i++;
+                        } else if (is_align(*i)) {
+                                align_ = *i++;
+                        }
+                }
+                while (i != end && '0' <= *i && *i <= '9') width_ = width_ * 10 + static_cast<std::size_t>(*i++ - '0');
+
                 while (i != end && *i != '}') {
                         switch (*i) {
                         case 'c': // 2‑digit precision, rounded to total (quadrature) error
@@ -691,6 +2040,9 @@ struct fmt::formatter<rounder::measurement> {
                                 break;
                         case 'L': // label list – not supported in the single‑char API;
                                 break;
+                        case 'P': // errors as percentages of the central value
+                                opts_.percent_errors = true;
+                                break;
                         case 'N': // suppress trailing newline
                                 // always false - delegate newline to fmt
                                 break;
@@ -718,10 +2070,36 @@ struct fmt::formatter<rounder::measurement> {
         template<typename fmt_context>
         auto format(const rounder::measurement& m, fmt_context& ctx) const -> decltype(ctx.out())
         {
-                if (m.labels.size()) opts_.labels = &m.labels;
-                // copy not to alter the initial measurement
-                rounder::measurement mm(m);
-                std::string txt = rounder::format_numbers(m.central, mm.errors, opts_);
-                return fmt::format_to(ctx.out(), "{}", txt);
+                rounder::format_options o = opts_;
+                o.labels = m.labels.size() ? &m.labels : nullptr;
+                // the span overload does not alter the initial measurement
+                std::string txt = rounder::format_numbers(m.central, std::span<const rounder::number>(m.errors), o);
+                return write_padded(ctx.out(), txt);
+        }
+
+        // write `txt` padded to the width (counted in code points)
+        template <typename It>
+        It write_padded(It out, std::string_view txt) const
+        {
+                std::size_t cps = 0;
+                for (char c : txt) cps += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+                const std::size_t pad  = width_ > cps ? width_ - cps : 0;
+                const std::size_t left = align_ == '>' ? pad : align_ == '^' ? pad / 2 : 0;
+                for (std::size_t k = 0; k < left; ++k) out = std::copy(fill_, fill_ + fill_size_, out);
+                out = std::copy(txt.begin(), txt.end(), out);
+                for (std::size_t k = left; k < pad; ++k) out = std::copy(fill_, fill_ + fill_size_, out);
+                return out;
+        }
+};
+
+
+// printing a formatted_measurement renders it (once); the format-specifier
+// is the one of strings, its rounding options are set at construction
+template <>
+struct fmt::formatter<rounder::formatted_measurement> : fmt::formatter<fmt::string_view> {
+        template<typename fmt_context>
+        auto format(const rounder::formatted_measurement& m, fmt_context& ctx) const -> decltype(ctx.out())
+        {
+                return fmt::formatter<fmt::string_view>::format(m.str(), ctx);
         }
 };
@@ -0,0 +1,322 @@
+/* Binary files of measurements for roundlib: written from a
+ * `measurement_table`, mapped back in memory (POSIX) and formatted
+ * without parsing.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "roundlib_table.hpp"
+
+namespace rounder {
+
+/*---------------------------------------
+ * binary files of measurements (mmapped)
+ *---------------------------------------*/
+// Layout, in native byte order, with every array starting at a multiple of
+// 64 bytes: the header; for each column (central value, then errors) its
+// structure, the sign shared by all rows (-1, 0, +1) or `varies`; the offsets
+// of the `n`, `p` and `sgn` arrays of each column (`sgn` only if it varies);
+// the arrays, as in `measurement_table`; the label id of each row; the label
+// table: the size of each label set, the (offset, length) of each label in
+// the text that follows.
+namespace detail {
+
+struct file_header {
+        char magic[8];               // "RNDLIB\0\0"
+        std::uint32_t version;       // 1
+        std::uint32_t byte_order;    // 0x01020304 as written
+        std::uint64_t rows;
+        std::uint32_t n_errors;
+        std::uint32_t n_label_sets;  // including set 0, no labels
+        std::uint64_t label_ids;     // offsets from the start of the file
+        std::uint64_t labels;
+        std::uint64_t size;          // of the file
+};
+
+inline constexpr char file_magic[8] = {'R', 'N', 'D', 'L', 'I', 'B', 0, 0};
+inline constexpr std::int8_t sign_varies = 2;
+
+constexpr std::uint64_t align64(std::uint64_t off) { return (off + 63) & ~std::uint64_t(63); }
+
+} // namespace detail
+
+
+// Write a table to a binary file that `measurement_file` maps back without
+// parsing; return false on write errors.
+inline bool write_binary(std::FILE* f, const measurement_table& t)
+{
+        const std::size_t rows = t.size();
+        const std::size_t cols = 1 + t.n_errors();
+        auto col = [&t](std::size_t c) -> const measurement_table::column& {
+                return c == 0 ? t.central() : t.errors(c - 1);
+        };
+
+        // structure of each column
+        std::vector<std::int8_t> shape(cols);
+        for (std::size_t c = 0; c < cols; ++c) {
+                const auto& s = col(c).sgn;
+                shape[c] = rows && std::all_of(s.begin(), s.end(), [&](std::int8_t v) { return v == s[0]; })
+                         ? s[0] : detail::sign_varies;
+        }
+        // label table
+        const auto n_sets = static_cast<std::uint32_t>(t.n_label_sets());
+        std::vector<std::uint32_t> set_sizes;
+        std::vector<std::uint32_t> spans;
+        std::string text;
+        for (std::uint32_t k = 0; k < n_sets; ++k) {
+                const auto& set = t.label_set(k);
+                set_sizes.push_back(static_cast<std::uint32_t>(set.size()));
+                for (auto l : set) {
+                        spans.push_back(static_cast<std::uint32_t>(text.size()));
+                        spans.push_back(static_cast<std::uint32_t>(l.size()));
+                        text += l;
+                }
+        }
+
+        // offsets
+        std::vector<std::uint64_t> off(3 * cols);
+        std::uint64_t pos = detail::align64(sizeof(detail::file_header) + cols
+                                            + off.size() * sizeof(std::uint64_t) + 8);
+        for (std::size_t c = 0; c < cols; ++c) {
+                off[3 * c] = pos;
+                pos = detail::align64(pos + rows * sizeof(std::uint64_t));
+                off[3 * c + 1] = pos;
+                pos = detail::align64(pos + rows * sizeof(std::int32_t));
+                if (shape[c] == detail::sign_varies) {
+                        off[3 * c + 2] = pos;
+                        pos = detail::align64(pos + rows);
+                }
+        }
+        detail::file_header h{};
+        std::copy(std::begin(detail::file_magic), std::end(detail::file_magic), h.magic);
+        h.version      = 1;
+        h.byte_order   = 0x01020304;
+        h.rows         = rows;
+        h.n_errors     = static_cast<std::uint32_t>(t.n_errors());
+        h.n_label_sets = n_sets;
+        h.label_ids    = pos;
+        h.labels       = detail::align64(pos + rows * sizeof(std::uint32_t));
+        h.size         = h.labels + (set_sizes.size() + spans.size()) * sizeof(std::uint32_t) + text.size();
+
+        // write sequentially, padding up to each offset
+        std::uint64_t at = 0;
+        bool ok = true;
+        auto put = [&](std::uint64_t where, const void* data, std::size_t bytes) {
+                for (; at < where; ++at) ok &= std::fputc(0, f) != EOF;
+                if (bytes) ok &= std::fwrite(data, 1, bytes, f) == bytes;
+                at += bytes;
+        };
+        put(0, &h, sizeof(h));
+        put(at, shape.data(), cols);
+        put((at + 7) & ~std::uint64_t(7), off.data(), off.size() * sizeof(std::uint64_t));
+        for (std::size_t c = 0; c < cols; ++c) {
+                put(off[3 * c], col(c).n.data(), rows * sizeof(std::uint64_t));
+                put(off[3 * c + 1], col(c).p.data(), rows * sizeof(std::int32_t));
+                if (shape[c] == detail::sign_varies) put(off[3 * c + 2], col(c).sgn.data(), rows);
+        }
+        put(h.label_ids, t.label_ids().data(), rows * sizeof(std::uint32_t));
+        put(h.labels, set_sizes.data(), set_sizes.size() * sizeof(std::uint32_t));
+        put(at, spans.data(), spans.size() * sizeof(std::uint32_t));
+        put(at, text.data(), text.size());
+        return ok && std::fflush(f) == 0;
+}
+
+
+// A binary file of measurements mapped in memory, read-only: rows are
+// accessed at random and formatted without parsing. The labels are views
+// into the mapping, valid as long as the file is.
+class measurement_file {
+      public:
+        explicit measurement_file(const char* path)
+        {
+                int fd = ::open(path, O_RDONLY);
+                struct stat st{};
+                if (fd < 0 || ::fstat(fd, &st) < 0) error(path, "cannot open");
+                size_ = static_cast<std::size_t>(st.st_size);
+                if (size_ < sizeof(detail::file_header)) error(path, "not a measurement file");
+                void* m = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (m == MAP_FAILED) error(path, "cannot map");
+                base_ = static_cast<const char*>(m);
+                load(path);
+        }
+
+        measurement_file(const measurement_file&) = delete;
+        measurement_file& operator=(const measurement_file&) = delete;
+
+        ~measurement_file() { ::munmap(const_cast<char*>(base_), size_); }
+
+        std::size_t size()     const noexcept { return rows_; }
+        std::size_t n_errors() const noexcept { return cols_.size() - 1; }
+
+        number central(std::size_t i) const noexcept { return cols_[0].get(i); }
+        number error(std::size_t i, std::size_t j) const noexcept { return cols_[j + 1].get(i); }
+        const std::vector<std::string_view>& labels(std::size_t i) const noexcept
+        {
+                return label_sets_[label_ids_[i]];
+        }
+
+        // copy into a table, e.g. to format it in parallel
+        measurement_table to_table() const
+        {
+                measurement_table t(n_errors());
+                t.reserve(rows_);
+                std::vector<number> e;
+                for (std::size_t i = 0; i < rows_; ++i) {
+                        number c = load_row(i, e);
+                        t.append(c, e, labels(i));
+                }
+                return t;
+        }
+
+        // round and format every row, as `measurement_table::format`; a file
+        // without errors holds plain numbers, rounded to `sig_digits` as `format_sig`
+        std::vector<std::string> format(const format_options& opt = {}, int sig_digits = 3) const
+        {
+                std::vector<std::string> out(rows_);
+                format_to(out, 0, rows_, opt, sig_digits);
+                return out;
+        }
+
+        // round and format the rows [first, last) into out[first, last)
+        void format_to(std::span<std::string> out, std::size_t first, std::size_t last,
+                       const format_options& opt = {}, int sig_digits = 3) const
+        {
+                if (n_errors() == 0) {
+                        for (std::size_t i = first; i < last; ++i) {
+                                format_options o = opt;
+                                if (label_ids_[i]) o.labels = &labels(i);
+                                out[i] = format_sig(central(i), sig_digits, o);
+                        }
+                        return;
+                }
+                std::vector<number> e;
+                // with a shared sign per column, the structure is known from the header
+                std::optional<error_schema> schema;
+                if (!opt.symmetrize_errors && rows_
+                    && std::none_of(cols_.begin() + 1, cols_.end(), [](const column_view& v) { return v.sgn; })) {
+                        load_row(0, e);
+                        schema.emplace(e);
+                }
+                for (std::size_t i = first; i < last; ++i) {
+                        format_options o = opt;
+                        if (label_ids_[i]) o.labels = &labels(i);
+                        number c = load_row(i, e);
+                        e.resize(detail::round(c, std::span<number>(e), o));
+                        out[i].clear();
+                        if (schema) formatter(o).format_to(out[i], c, e, *schema);
+                        else        formatter(o).format_to(out[i], c, e);
+                }
+        }
+
+      private:
+        struct column_view {
+                const std::uint64_t* n;
+                const std::int32_t* p;
+                const std::int8_t* sgn; // null if shared by all rows
+                int shared;
+                number get(std::size_t i) const noexcept
+                {
+                        number r;
+                        r.n   = n[i];
+                        r.p   = p[i];
+                        r.sgn = sgn ? sgn[i] : shared;
+                        return r;
+                }
+        };
+
+        const char* base_ = nullptr;
+        std::size_t size_ = 0;
+        std::size_t rows_ = 0;
+        std::vector<column_view> cols_;
+        const std::uint32_t* label_ids_ = nullptr;
+        std::vector<std::vector<std::string_view>> label_sets_;
+
+        [[noreturn]] static void error(const char* path, std::string_view what)
+        {
+                fmt::println("# error: {} {}", what, path);
+                std::exit(1);
+        }
+
+        // `count` elements of type T at `off`, which must be aligned for T and
+        // within the file (checked by division, without overflow)
+        template <typename T>
+        const T* array(const char* path, std::uint64_t off, std::uint64_t count) const
+        {
+                if (off % alignof(T) || off > size_ || count > (size_ - off) / sizeof(T))
+                        error(path, "truncated or misaligned measurement file");
+                return reinterpret_cast<const T*>(base_ + off);
+        }
+
+        // validate the header and the offsets, set up the views
+        void load(const char* path)
+        {
+                detail::file_header h;
+                std::memcpy(&h, base_, sizeof(h));
+                if (!std::equal(h.magic, h.magic + 8, detail::file_magic) || h.version != 1
+                    || h.byte_order != 0x01020304 || h.size != size_)
+                        error(path, "not a measurement file (or another version or byte order)");
+                // every count is bounded by the file size before any offset
+                // or size is computed from it, so that nothing overflows
+                if (h.rows > size_ / sizeof(std::uint64_t) || h.n_errors >= size_ / (3 * sizeof(std::uint64_t))
+                    || h.n_label_sets > size_ / sizeof(std::uint32_t))
+                        error(path, "corrupt measurement file");
+                rows_ = h.rows;
+                const std::size_t cols = std::size_t(h.n_errors) + 1;
+                const auto* shape = array<std::int8_t>(path, sizeof(h), cols);
+                const auto* off   = array<std::uint64_t>(path, (sizeof(h) + cols + 7) & ~std::size_t(7), 3 * cols);
+                for (std::size_t c = 0; c < cols; ++c) {
+                        if (shape[c] < -1 || shape[c] > detail::sign_varies) error(path, "invalid column sign in");
+                        column_view v;
+                        v.n      = array<std::uint64_t>(path, off[3 * c], rows_);
+                        v.p      = array<std::int32_t>(path, off[3 * c + 1], rows_);
+                        v.sgn    = shape[c] == detail::sign_varies ? array<std::int8_t>(path, off[3 * c + 2], rows_) : nullptr;
+                        v.shared = shape[c] == detail::sign_varies ? 0 : shape[c];
+                        cols_.push_back(v);
+                }
+                label_ids_ = array<std::uint32_t>(path, h.label_ids, rows_);
+
+                const auto* sizes = array<std::uint32_t>(path, h.labels, h.n_label_sets);
+                std::uint64_t n_labels = 0;
+                for (std::size_t k = 0; k < h.n_label_sets; ++k) n_labels += sizes[k];
+                if (n_labels > size_ / (2 * sizeof(std::uint32_t))) error(path, "corrupt measurement file");
+                const auto* spans = array<std::uint32_t>(path, h.labels + h.n_label_sets * sizeof(std::uint32_t), 2 * n_labels);
+                const std::uint64_t text_off = h.labels + (h.n_label_sets + 2 * n_labels) * sizeof(std::uint32_t);
+                label_sets_.resize(std::max<std::size_t>(h.n_label_sets, 1));
+                for (std::size_t k = 0, l = 0; k < h.n_label_sets; ++k)
+                        for (std::uint32_t m = 0; m < sizes[k]; ++m, ++l)
+                                label_sets_[k].emplace_back(array<char>(path, text_off + spans[2 * l], spans[2 * l + 1]),
+                                                            spans[2 * l + 1]);
+                for (std::size_t i = 0; i < rows_; ++i)
+                        if (label_ids_[i] >= label_sets_.size()) error(path, "invalid label id in");
+        }
+
+        number load_row(std::size_t i, std::vector<number>& e) const
+        {
+                e.resize(n_errors());
+                for (std::size_t j = 0; j < e.size(); ++j) e[j] = cols_[j + 1].get(i);
+                return cols_[0].get(i);
+        }
+};
+} // namespace rounder
@@ -0,0 +1,539 @@
+/* Deferred logging of measurements for roundlib: `deferred_logger` and
+ * `measurement_sink`, which round, format and write on a background thread.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "roundlib.hpp"
+
+namespace rounder {
+
+/*-----------------------------------
+ * deferred logging of measurements
+ *-----------------------------------*/
+namespace detail {
+
+// single-producer single-consumer ring buffer of trivially copyable records
+template <typename T, std::size_t N>
+class spsc_ring {
+        static_assert((N & (N - 1)) == 0, "the capacity must be a power of two");
+
+      public:
+        // producer side: false if the ring is full
+        bool push(const T& v) noexcept
+        {
+                const std::size_t h = head_.load(std::memory_order_relaxed);
+                if (h - tail_cache_ == N) {
+                        tail_cache_ = tail_.load(std::memory_order_acquire);
+                        if (h - tail_cache_ == N) return false;
+                }
+                buf_[h & (N - 1)] = v;
+                head_.store(h + 1, std::memory_order_release);
+                return true;
+        }
+
+        // consumer side: pass the available records to `f`, return how many
+        template <typename F>
+        std::size_t consume(F&& f)
+        {
+                std::size_t t = tail_.load(std::memory_order_relaxed);
+                const std::size_t h = head_.load(std::memory_order_acquire);
+                for (std::size_t i = t; i != h; ++i) f(buf_[i & (N - 1)]);
+                tail_.store(h, std::memory_order_release);
+                return h - t;
+        }
+
+      private:
+        alignas(64) std::atomic<std::size_t> head_{0};
+        std::size_t tail_cache_ = 0; // producer's copy of tail_
+        alignas(64) std::atomic<std::size_t> tail_{0};
+        alignas(64) std::array<T, N> buf_;
+};
+
+
+// a measurement packed for the log: central value first, then the errors
+struct log_record {
+        static constexpr std::size_t max_numbers = 8;
+        std::uint64_t n[max_numbers];
+        std::int16_t  p[max_numbers];
+        std::int8_t   sgn[max_numbers];
+        std::uint16_t options;
+        std::uint16_t labels;
+        std::uint8_t  size;
+};
+
+
+// format_options without the labels, on `option_bits` bits: the display
+// mode on 2, then one bit per option
+inline constexpr int option_bits = 9;
+
+constexpr std::uint16_t pack_options(const format_options& opt)
+{
+        return static_cast<std::uint16_t>(static_cast<unsigned>(opt.mode)
+               | static_cast<unsigned>(opt.round) << 2
+               | static_cast<unsigned>(opt.prec) << 3
+               | opt.symmetrize_errors << 4
+               | opt.factorize_powers << 5
+               | opt.no_utf8 << 6
+               | opt.cdot << 7
+               | opt.percent_errors << 8);
+}
+
+
+constexpr format_options unpack_options(std::uint16_t bits)
+{
+        format_options opt;
+        opt.mode  = static_cast<mode_type>(bits & 3u);
+        opt.round = static_cast<format_options::round_algo>((bits >> 2) & 1u);
+        opt.prec  = static_cast<format_options::prec_algo>((bits >> 3) & 1u);
+        opt.symmetrize_errors = (bits >> 4) & 1u;
+        opt.factorize_powers  = (bits >> 5) & 1u;
+        opt.no_utf8           = (bits >> 6) & 1u;
+        opt.cdot              = (bits >> 7) & 1u;
+        opt.percent_errors    = (bits >> 8) & 1u;
+        return opt;
+}
+
+static_assert(option_bits <= 8 * sizeof(log_record::options), "the packed options must fit in a record");
+static_assert(static_cast<unsigned>(mode_type::gnuplot) < 4, "the display mode is packed on 2 bits");
+static_assert([] {
+        format_options o;
+        o.mode  = mode_type::gnuplot;
+        o.round = format_options::round_algo::twodigits;
+        o.prec  = format_options::prec_algo::total_error;
+        o.symmetrize_errors = o.factorize_powers = o.no_utf8 = o.cdot = o.percent_errors = 1;
+        return pack_options(o) < (1u << option_bits) && unpack_options(pack_options(o)).percent_errors;
+}(), "every option must be packed within option_bits");
+
+
+// pack a measurement in a record, false if the errors are too many
+// or an exponent does not fit in the record
+inline bool pack_record(log_record& r, const number& central, std::span<const number> errors,
+                        const format_options& opt, std::uint16_t labels) noexcept
+{
+        if (errors.size() >= log_record::max_numbers) return false;
+        constexpr auto fits = [](const number& v) {
+                return v.p >= std::numeric_limits<std::int16_t>::min() && v.p <= std::numeric_limits<std::int16_t>::max();
+        };
+        if (!fits(central) || !std::all_of(errors.begin(), errors.end(), fits)) return false;
+        r.size    = static_cast<std::uint8_t>(errors.size() + 1);
+        r.options = pack_options(opt);
+        r.labels  = labels;
+        for (std::size_t i = 0; i < r.size; ++i) {
+                const number& v = i ? errors[i - 1] : central;
+                r.n[i]   = v.n;
+                r.p[i]   = static_cast<std::int16_t>(v.p);
+                r.sgn[i] = static_cast<std::int8_t>(v.sgn);
+        }
+        return true;
+}
+
+
+// append a record as a line of text, rounding it first if `round`
+// (`e` is a reusable error buffer, `labels` the registered label sets);
+// on a background thread, a record that cannot be rounded is replaced
+// by the error message and false is returned
+inline bool write_record(std::string& buf, std::vector<number>& e, const log_record& r,
+                         const std::vector<std::vector<std::string_view>>& labels, bool round)
+{
+        format_options o = unpack_options(r.options);
+        o.labels = r.labels && r.labels < labels.size() ? &labels[r.labels] : nullptr;
+        auto get = [&r](std::size_t i) {
+                number v;
+                v.n   = r.n[i];
+                v.p   = r.p[i];
+                v.sgn = r.sgn[i];
+                return v;
+        };
+        number c = get(0);
+        e.resize(r.size - 1);
+        for (std::size_t j = 0; j < e.size(); ++j) e[j] = get(j + 1);
+        const std::size_t start = buf.size();
+        try {
+                if (round) e.resize(detail::round(c, std::span<number>(e), o));
+                formatter(o).format_to(buf, c, e);
+        } catch (const round_error& err) {
+                buf.resize(start);
+                buf += err.what();
+                buf += '\n';
+                return false;
+        }
+        buf += '\n';
+        return true;
+}
+
+
+// label sets registered by producers and read by a background thread,
+// which copies the new ones instead of reading them under the lock
+class label_registry {
+      public:
+        label_registry() : sets_(1) {} // label id 0: no labels
+
+        std::uint16_t add(std::vector<std::string_view> labels)
+        {
+                std::lock_guard<std::mutex> lock(mtx_);
+                sets_.push_back(std::move(labels));
+                size_.store(sets_.size(), std::memory_order_release);
+                return static_cast<std::uint16_t>(sets_.size() - 1);
+        }
+
+        // append to `local` the sets registered since the last call
+        void sync(std::vector<std::vector<std::string_view>>& local)
+        {
+                if (size_.load(std::memory_order_acquire) == local.size()) return;
+                std::lock_guard<std::mutex> lock(mtx_);
+                local.insert(local.end(), sets_.begin() + local.size(), sets_.end());
+        }
+
+      private:
+        std::mutex mtx_;
+        std::vector<std::vector<std::string_view>> sets_;
+        std::atomic<std::size_t> size_{1};
+};
+
+
+// the background thread of the logger and of the sink: `drain(buf, flush)`
+// appends the pending lines to `buf` (calling `flush()` to write a large
+// buffer early) and returns how many it took, `write(text)` writes; no lock
+// is held meanwhile. The thread sleeps for `idle` when there was nothing
+// to do; after stop() the last lines are drained and written.
+class background_writer {
+      public:
+        background_writer() = default;
+        background_writer(const background_writer&) = delete;
+        background_writer& operator=(const background_writer&) = delete;
+        ~background_writer() { stop(); }
+
+        template <typename Drain, typename Write>
+        void start(std::chrono::microseconds idle, Drain drain, Write write)
+        {
+                thread_ = std::thread([this, idle, drain = std::move(drain), write = std::move(write)]() mutable {
+                        recover_errors = true;
+                        std::string buf;
+                        auto flush = [&] {
+                                if (!buf.empty()) write(std::string_view(buf));
+                                buf.clear();
+                        };
+                        for (;;) {
+                                const bool stopping = stop_.load(std::memory_order_acquire);
+                                const std::size_t cnt = drain(buf, flush);
+                                flush();
+                                if (stopping) break;
+                                if (cnt == 0) std::this_thread::sleep_for(idle);
+                        }
+                });
+        }
+
+        void stop()
+        {
+                stop_.store(true, std::memory_order_release);
+                if (thread_.joinable()) thread_.join();
+        }
+
+      private:
+        std::atomic<bool> stop_{false};
+        std::thread thread_;
+};
+
+} // namespace detail
+
+
+// Log measurements from latency-critical threads: log() only packs the
+// numbers and the options into a binary record in a buffer owned by the
+// calling thread, a background thread rounds, formats and writes them,
+// one per line. Records from one thread keep their order, those from
+// different threads may interleave. The buffers are lock-free; a lock is
+// only taken the first time a thread logs and when registering labels,
+// never while formatting or writing. A record that cannot be rounded is
+// written as its error message and counted as dropped.
+class deferred_logger {
+      public:
+        static constexpr std::size_t ring_capacity = 4096; // records per thread
+
+        explicit deferred_logger(std::FILE* out,
+                                 std::chrono::microseconds idle = std::chrono::microseconds(500))
+            : out_(out), id_(next_id())
+        {
+                worker_.start(idle, [this](std::string& buf, auto& flush) { return drain(buf, flush); },
+                              [this](std::string_view text) {
+                                      std::fwrite(text.data(), 1, text.size(), out_);
+                                      std::fflush(out_);
+                              });
+        }
+
+        deferred_logger(const deferred_logger&) = delete;
+        deferred_logger& operator=(const deferred_logger&) = delete;
+
+        // write what has been logged so far, then stop
+        ~deferred_logger() { worker_.stop(); }
+
+        // register a set of labels, the views must outlive the logger
+        std::uint16_t add_labels(std::vector<std::string_view> labels)
+        {
+                return labels_.add(std::move(labels));
+        }
+
+        // hot path: false if the record is dropped, because the thread's
+        // buffer is full, the errors are too many or an exponent is too large
+        bool log(const number& central, std::span<const number> errors,
+                 const format_options& opt = {}, std::uint16_t labels = 0)
+        {
+                detail::log_record r;
+                if (detail::pack_record(r, central, errors, opt, labels) && local_ring().push(r)) return true;
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+        }
+
+        std::uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+      private:
+        using ring = detail::spsc_ring<detail::log_record, ring_capacity>;
+
+        std::FILE* out_;
+        std::uint64_t id_;
+        std::mutex mtx_;
+        std::vector<std::shared_ptr<ring>> rings_;
+        std::atomic<std::size_t> n_rings_{0};
+        detail::label_registry labels_;
+        std::atomic<std::uint64_t> dropped_{0};
+        // used by the background thread only
+        std::vector<ring*> seen_rings_;
+        std::vector<std::vector<std::string_view>> seen_labels_;
+        std::vector<number> e_;
+        detail::background_writer worker_;
+
+        // identifies the logger in the per-thread ring cache, unlike its address
+        static std::uint64_t next_id()
+        {
+                static std::atomic<std::uint64_t> id{1};
+                return id.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // the ring of the calling thread, created on its first use; the
+        // entries of destroyed loggers are pruned from the cache then
+        ring& local_ring()
+        {
+                struct cached {
+                        std::uint64_t id;
+                        ring* r;
+                        std::weak_ptr<ring> alive;
+                };
+                thread_local std::vector<cached> cache;
+                for (const auto& c : cache)
+                        if (c.id == id_) return *c.r;
+                std::erase_if(cache, [](const cached& c) { return c.alive.expired(); });
+                std::lock_guard<std::mutex> lock(mtx_);
+                rings_.push_back(std::make_shared<ring>());
+                n_rings_.store(rings_.size(), std::memory_order_release);
+                cache.push_back({id_, rings_.back().get(), rings_.back()});
+                return *rings_.back();
+        }
+
+        // background thread: format the records of all the rings
+        template <typename Flush>
+        std::size_t drain(std::string& buf, Flush& flush)
+        {
+                if (n_rings_.load(std::memory_order_acquire) != seen_rings_.size()) {
+                        std::lock_guard<std::mutex> lock(mtx_);
+                        for (std::size_t i = seen_rings_.size(); i < rings_.size(); ++i)
+                                seen_rings_.push_back(rings_[i].get());
+                }
+                labels_.sync(seen_labels_);
+                std::size_t cnt = 0;
+                for (ring* r : seen_rings_) cnt += r->consume([&](const detail::log_record& rec) {
+                        if (!detail::write_record(buf, e_, rec, seen_labels_, true))
+                                dropped_.fetch_add(1, std::memory_order_relaxed);
+                        if (buf.size() > (1 << 16)) flush();
+                });
+                return cnt;
+        }
+};
+
+
+namespace detail {
+
+// bounded multi-producer single-consumer queue: each cell carries a sequence
+// number telling whether it is free for the producer of a given position
+// or ready for the consumer (D. Vyukov's bounded queue)
+template <typename T>
+class mpsc_queue {
+      public:
+        explicit mpsc_queue(std::size_t capacity)
+            : mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+              cells_(std::make_unique<cell[]>(mask_ + 1))
+        {
+                for (std::size_t i = 0; i <= mask_; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        // any thread: false if the queue is full
+        bool push(T&& v)
+        {
+                std::size_t pos = head_.load(std::memory_order_relaxed);
+                cell* c;
+                for (;;) {
+                        c = &cells_[pos & mask_];
+                        const std::size_t seq = c->seq.load(std::memory_order_acquire);
+                        const auto dif = static_cast<std::ptrdiff_t>(seq - pos);
+                        if (dif == 0) {
+                                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                        } else if (dif < 0) {
+                                return false;
+                        } else {
+                                pos = head_.load(std::memory_order_relaxed);
+                        }
+                }
+                c->data = std::move(v);
+                c->seq.store(pos + 1, std::memory_order_release);
+                return true;
+        }
+
+        // consumer thread only: false if the queue is empty
+        bool pop(T& v)
+        {
+                cell& c = cells_[tail_ & mask_];
+                if (c.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+                v = std::move(c.data);
+                c.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+                ++tail_;
+                return true;
+        }
+
+      private:
+        struct cell {
+                std::atomic<std::size_t> seq;
+                T data;
+        };
+        std::size_t mask_;
+        std::unique_ptr<cell[]> cells_;
+        alignas(64) std::atomic<std::size_t> head_{0};
+        alignas(64) std::size_t tail_ = 0;
+};
+
+} // namespace detail
+
+
+// Collect lines from many threads into a file: producers push formatted
+// text, or measurements already rounded which are then only formatted,
+// into a lock-free queue; a background thread writes them in batches with
+// a single fwrite() each, so lines never interleave. A record that cannot
+// be formatted is written as its error message and counted as dropped.
+class measurement_sink {
+      public:
+        explicit measurement_sink(std::FILE* out, std::size_t capacity = 1 << 14,
+                                  std::chrono::microseconds idle = std::chrono::microseconds(500))
+            : out_(out), queue_(capacity)
+        {
+                worker_.start(idle, [this](std::string& buf, auto& flush) { return drain(buf, flush); },
+                              [this](std::string_view text) { write(text); });
+        }
+
+        measurement_sink(const measurement_sink&) = delete;
+        measurement_sink& operator=(const measurement_sink&) = delete;
+
+        // write what has been pushed so far, then stop
+        ~measurement_sink() { worker_.stop(); }
+
+        // register a set of labels, the views must outlive the sink
+        std::uint16_t add_labels(std::vector<std::string_view> labels)
+        {
+                return labels_.add(std::move(labels));
+        }
+
+        // a formatted line (the new line is appended), false if the queue is full
+        bool push(std::string line)
+        {
+                return enqueue(entry{{}, std::move(line)});
+        }
+
+        // a measurement rounded by the caller, formatted by the sink; false if
+        // the queue is full, the errors are too many or an exponent is too large
+        bool push(const number& central, std::span<const number> errors,
+                  const format_options& opt = {}, std::uint16_t labels = 0)
+        {
+                entry en;
+                if (!detail::pack_record(en.rec, central, errors, opt, labels)) {
+                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                }
+                return enqueue(std::move(en));
+        }
+
+        std::uint64_t dropped() const noexcept { return dropped_.load(std::memory_order_relaxed); }
+
+      private:
+        // a record (rec.size > 0) or a line of text
+        struct entry {
+                detail::log_record rec{};
+                std::string text;
+        };
+
+        std::FILE* out_;
+        detail::mpsc_queue<entry> queue_;
+        detail::label_registry labels_;
+        std::atomic<std::uint64_t> dropped_{0};
+        // used by the background thread only
+        std::vector<std::vector<std::string_view>> seen_labels_;
+        std::vector<number> e_;
+        entry en_;
+        detail::background_writer worker_;
+
+        bool enqueue(entry&& en)
+        {
+                if (queue_.push(std::move(en))) return true;
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+        }
+
+        // background thread: batch what is queued
+        template <typename Flush>
+        std::size_t drain(std::string& buf, Flush& flush)
+        {
+                labels_.sync(seen_labels_);
+                std::size_t cnt = 0;
+                while (queue_.pop(en_)) {
+                        ++cnt;
+                        if (en_.rec.size) {
+                                if (!detail::write_record(buf, e_, en_.rec, seen_labels_, false))
+                                        dropped_.fetch_add(1, std::memory_order_relaxed);
+                        } else {
+                                buf += en_.text;
+                                buf += '\n';
+                        }
+                        if (buf.size() > (1 << 16)) flush();
+                }
+                return cnt;
+        }
+
+        void write(std::string_view text)
+        {
+                if (std::fwrite(text.data(), 1, text.size(), out_) != text.size() || std::fflush(out_) != 0)
+                        fmt::println(stderr, "# error: cannot write the measurements");
+        }
+};
+} // namespace rounder
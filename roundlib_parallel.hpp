@@ -0,0 +1,85 @@
+/* Formatting of a `measurement_table` on several cores, with a standard
+ * execution policy (roundlib).
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "roundlib_table.hpp"
+
+namespace rounder {
+
+namespace detail {
+
+// a standard execution policy: the parallel algorithms are declared
+// by <algorithm> and defined by <execution>, included by the caller
+template <typename E>
+concept execution_policy = requires(E&& policy, std::size_t* i) {
+        std::for_each(std::forward<E>(policy), i, i, [](std::size_t) {});
+};
+
+struct table_chunks {
+        template <typename E, typename Round>
+        static std::vector<std::string> format(E&& policy, const measurement_table& t,
+                                               const format_options& opt, Round&& round)
+        {
+                std::vector<std::string> out(t.size());
+                const std::size_t chunk = t.chunk_rows();
+                std::vector<std::size_t> starts;
+                starts.reserve(t.size() / chunk + 1);
+                for (std::size_t i = 0; i < t.size(); i += chunk) starts.push_back(i);
+                std::vector<std::size_t> rep;
+                if (opt.deduplicate) rep = t.representatives();
+                auto schema = t.schema(opt);
+                std::for_each(policy, starts.begin(), starts.end(), [&](std::size_t first) {
+                        t.format_rows(out, first, std::min(first + chunk, t.size()), opt, round,
+                                      schema ? &*schema : nullptr, opt.deduplicate ? &rep : nullptr);
+                });
+                if (!opt.deduplicate) return out;
+                // scatter the results once all the representatives are formatted
+                std::for_each(std::forward<E>(policy), starts.begin(), starts.end(), [&](std::size_t first) {
+                        for (std::size_t i = first; i < std::min(first + chunk, t.size()); ++i)
+                                if (rep[i] != i) out[i] = out[rep[i]];
+                });
+                return out;
+        }
+};
+
+} // namespace detail
+
+
+// as measurement_table::format(), the rows are formatted by chunks of
+// chunk_rows() distributed according to a standard execution policy, e.g.
+// std::execution::par (the caller includes <execution>)
+template <detail::execution_policy E>
+inline std::vector<std::string> format_parallel(E&& policy, const measurement_table& t, const format_options& opt = {})
+{
+        return detail::table_chunks::format(std::forward<E>(policy), t, opt, detail::builtin_rounder{});
+}
+
+template <rounding_policy P, detail::execution_policy E>
+inline std::vector<std::string> format_parallel(E&& policy, const measurement_table& t, const format_options& opt = {})
+{
+        return detail::table_chunks::format(std::forward<E>(policy), t, opt, detail::policy_rounder<P>{});
+}
+
+} // namespace rounder
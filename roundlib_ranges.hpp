@@ -0,0 +1,217 @@
+/* Lazy formatting of ranges of measurements for roundlib: the view
+ * `views::rounded` and `join`, printed with fmt.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "roundlib.hpp"
+
+namespace rounder {
+
+/*--------------------------------------------
+ * lazy formatting of ranges of measurements
+ *--------------------------------------------*/
+namespace detail {
+
+// copy (or convert) the errors of a range element into `out`
+template <typename E>
+inline void load_errors(const E& err, const number& central, std::vector<number>& out)
+{
+        out.clear();
+        if constexpr (is_container_v<E>) {
+                if constexpr (std::same_as<typename E::value_type, number>)
+                        out.assign(std::begin(err), std::end(err));
+                else
+                        for (const auto& e : err) out.push_back(error_from_anything(e, central));
+        } else {
+                out.push_back(error_from_anything(err, central));
+        }
+}
+
+} // namespace detail
+
+
+namespace views {
+
+// A view of the rounded and formatted text of each element of `R`, computed
+// when the element is read into a buffer reused for the whole range: each
+// `std::string_view` is valid until the iterator is incremented. Elements
+// are `measurement`s or tuple-likes (value, error(s)), with value and errors
+// as accepted by `rounder::format`. Single pass (an input range).
+template <std::ranges::input_range R>
+        requires std::ranges::view<R>
+class rounded_view : public std::ranges::view_interface<rounded_view<R>> {
+      public:
+        rounded_view() = default;
+        rounded_view(R base, const format_options& opt) : base_(std::move(base)), opt_(opt) {}
+
+        class iterator {
+              public:
+                using iterator_concept = std::input_iterator_tag;
+                using value_type       = std::string_view;
+                using difference_type  = std::ptrdiff_t;
+
+                iterator() = default;
+                iterator(rounded_view* parent, std::ranges::iterator_t<R> it)
+                    : parent_(parent), it_(std::move(it))
+                {}
+
+                std::string_view operator*() const { return parent_->render(*it_); }
+                iterator& operator++()
+                {
+                        ++it_;
+                        parent_->fresh_ = false;
+                        return *this;
+                }
+                void operator++(int) { ++*this; }
+
+                friend bool operator==(const iterator& i, const std::ranges::sentinel_t<R>& s)
+                {
+                        return i.it_ == s;
+                }
+
+              private:
+                rounded_view* parent_ = nullptr;
+                std::ranges::iterator_t<R> it_{};
+        };
+
+        iterator begin()
+        {
+                fresh_ = false;
+                return {this, std::ranges::begin(base_)};
+        }
+        std::ranges::sentinel_t<R> end() { return std::ranges::end(base_); }
+
+        R base() const& { return base_; }
+        R base() && { return std::move(base_); }
+
+      private:
+        R base_{};
+        format_options opt_{};
+        std::string buf_;
+        std::vector<number> errors_;
+        bool fresh_ = false; // buf_ holds the current element
+
+        template <typename T>
+        std::string_view render(const T& el)
+        {
+                if (fresh_) return buf_;
+                buf_.clear();
+                if constexpr (std::same_as<T, measurement>) {
+                        format_options o = opt_;
+                        if (!el.labels.empty()) o.labels = &el.labels;
+                        errors_.assign(el.errors.begin(), el.errors.end());
+                        detail::format_append(buf_, el.central, errors_, o);
+                } else {
+                        const auto& [val, err] = el;
+                        const number central = number::from_anything(val);
+                        detail::load_errors(err, central, errors_);
+                        detail::format_append(buf_, central, errors_, opt_);
+                }
+                fresh_ = true;
+                return buf_;
+        }
+};
+
+template <typename R>
+rounded_view(R&&, const format_options&) -> rounded_view<std::views::all_t<R>>;
+
+
+// the result of `views::rounded(opt)`, applied with `range | views::rounded(opt)`
+struct rounded_closure {
+        format_options opt;
+
+        template <std::ranges::viewable_range R>
+        friend auto operator|(R&& r, const rounded_closure& c)
+        {
+                return rounded_view(std::views::all(std::forward<R>(r)), c.opt);
+        }
+};
+
+struct rounded_fn {
+        template <std::ranges::viewable_range R>
+        auto operator()(R&& r, const format_options& opt = {}) const
+        {
+                return rounded_view(std::views::all(std::forward<R>(r)), opt);
+        }
+        rounded_closure operator()(const format_options& opt = {}) const { return {opt}; }
+};
+
+inline constexpr rounded_fn rounded{};
+
+} // namespace views
+
+
+// A range of measurements and a separator, printed with fmt in one pass:
+// the format-specifier (as for a `measurement`) is parsed once and the
+// scratch buffers are shared by all the elements, e.g.
+//     fmt::print("{:tF}", rounder::join(measurements, "\n"));
+template <std::ranges::input_range R>
+struct measurement_join {
+        R range;
+        std::string_view sep;
+};
+
+template <std::ranges::viewable_range R>
+        requires std::ranges::input_range<const std::views::all_t<R>>
+inline auto join(R&& r, std::string_view sep)
+{
+        return measurement_join<std::views::all_t<R>>{std::views::all(std::forward<R>(r)), sep};
+}
+
+} // namespace rounder
+
+
+// the format-specifier is the one of `measurement`, applied to all the elements
+template <typename R>
+struct fmt::formatter<rounder::measurement_join<R>> {
+        fmt::formatter<rounder::measurement> elem_;
+
+        constexpr auto parse(fmt::format_parse_context& ctx) -> decltype(ctx.begin())
+        {
+                return elem_.parse(ctx);
+        }
+
+        template<typename fmt_context>
+        auto format(const rounder::measurement_join<R>& j, fmt_context& ctx) const -> decltype(ctx.out())
+        {
+                std::string buf;
+                std::vector<rounder::number> errors;
+                auto out = ctx.out();
+                bool first = true;
+                for (const rounder::measurement& m : j.range) {
+                        if (!first) out = std::copy(j.sep.begin(), j.sep.end(), out);
+                        first = false;
+                        rounder::format_options o = elem_.opts_;
+                        o.labels = m.labels.size() ? &m.labels : nullptr;
+                        errors.assign(m.errors.begin(), m.errors.end());
+                        buf.clear();
+                        rounder::detail::format_append(buf, m.central, errors, o);
+                        out = elem_.write_padded(out, buf);
+                }
+                return out;
+        }
+};
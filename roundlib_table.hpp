@@ -0,0 +1,513 @@
+/* Columnar storage of many measurements for roundlib: `measurement_table`,
+ * and its rows written as gnuplot data.
+ *
+ * Copyright © 2025 Federico Ferri (federico.ferri@cea.fr)
+ *
+ * SPDX‑License‑Identifier: GPL-3.0-or-later
+ *
+ *  This program is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by the
+ *  Free Software Foundation, either version 3 of the License, or (at your
+ *  option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ *  or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "roundlib.hpp"
+
+namespace rounder {
+
+/*-------------------------------------
+ * columnar storage of many measurements
+ *-------------------------------------*/
+namespace detail {
+
+// allocator returning memory aligned to `Align` bytes (a cache line by default)
+template <typename T, std::size_t Align = 64>
+struct aligned_allocator {
+        using value_type = T;
+        template <typename U> struct rebind { using other = aligned_allocator<U, Align>; };
+
+        constexpr aligned_allocator() noexcept = default;
+        template <typename U>
+        constexpr aligned_allocator(const aligned_allocator<U, Align>&) noexcept {}
+
+        T* allocate(std::size_t n)
+        {
+                return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+        }
+        void deallocate(T* p, std::size_t) noexcept
+        {
+                ::operator delete(p, std::align_val_t{Align});
+        }
+
+        template <typename U>
+        bool operator==(const aligned_allocator<U, Align>&) const noexcept { return true; }
+        template <typename U>
+        bool operator!=(const aligned_allocator<U, Align>&) const noexcept { return false; }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+
+// combine a value into a hash (64-bit multiplicative mixing)
+constexpr std::size_t hash_mix(std::size_t h, std::uint64_t v)
+{
+        h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        return h * 0xff51afd7ed558ccdull;
+}
+
+// formatting of a table by chunks, in roundlib_parallel.hpp
+struct table_chunks;
+
+} // namespace detail
+
+
+// Measurements stored by columns: one aligned array per field instead of
+// three heap-allocated vectors per measurement. All the rows share the same
+// number of errors; labels are interned once and referenced by id.
+class measurement_table {
+      public:
+        // a column of numbers, split by field
+        struct column {
+                detail::aligned_vector<std::uint64_t> n;
+                detail::aligned_vector<std::int32_t>  p;
+                detail::aligned_vector<std::int8_t>   sgn;
+
+                number get(std::size_t i) const noexcept
+                {
+                        number r;
+                        r.n   = n[i];
+                        r.p   = p[i];
+                        r.sgn = sgn[i];
+                        return r;
+                }
+                void push_back(const number& v)
+                {
+                        n.push_back(v.n);
+                        p.push_back(v.p);
+                        sgn.push_back(static_cast<std::int8_t>(v.sgn));
+                }
+                void reserve(std::size_t sz)
+                {
+                        n.reserve(sz);
+                        p.reserve(sz);
+                        sgn.reserve(sz);
+                }
+        };
+
+        // read-only view of a single row
+        class row_view {
+              public:
+                number central() const noexcept { return t_->central_.get(i_); }
+                number error(std::size_t j) const noexcept { return t_->errors_[j].get(i_); }
+                std::uint32_t label_id() const noexcept { return t_->label_ids_[i_]; }
+                const std::vector<std::string_view>& labels() const noexcept
+                {
+                        return t_->label_sets_[label_id()];
+                }
+
+                // copy back to a row-wise measurement
+                measurement to_measurement() const
+                {
+                        measurement m{central(), {}, labels()};
+                        m.errors.reserve(t_->n_errors());
+                        for (std::size_t j = 0; j < t_->n_errors(); ++j) m.errors.push_back(error(j));
+                        return m;
+                }
+
+              private:
+                friend class measurement_table;
+                row_view(const measurement_table* t, std::size_t i) : t_(t), i_(i) {}
+                const measurement_table* t_;
+                std::size_t i_;
+        };
+
+        // an error element of the rows of a table built from elements
+        enum class element : std::uint8_t { symmetric, asymmetric };
+
+        explicit measurement_table(std::size_t n_errors = 1)
+            : errors_(n_errors), label_sets_(1) // label id 0: no labels
+        {}
+
+        // a table of rows of `error_element`s laid out as `elements`: an
+        // asymmetric pair is stored as such, in two adjacent columns (upper
+        // then lower), and the rows are rounded and formatted as elements
+        explicit measurement_table(std::vector<element> elements)
+            : label_sets_(1), elements_(std::move(elements))
+        {
+                std::size_t n = 0;
+                for (auto k : elements_) n += k == element::asymmetric ? 2 : 1;
+                errors_.resize(n);
+        }
+
+        std::size_t size()     const noexcept { return central_.n.size(); }
+        std::size_t n_errors() const noexcept { return errors_.size(); }
+        bool empty()           const noexcept { return size() == 0; }
+
+        void reserve(std::size_t rows)
+        {
+                central_.reserve(rows);
+                for (auto& c : errors_) c.reserve(rows);
+                label_ids_.reserve(rows);
+        }
+
+        // append a row, `errors` must contain exactly n_errors() elements
+        void append(const number& central, const std::vector<number>& errors,
+                    const std::vector<std::string_view>& labels = {})
+        {
+                if (errors.size() != n_errors()) {
+                        detail::fail("# error: measurement with {} errors appended to a table with {}",
+                                     errors.size(), n_errors());
+                }
+                central_.push_back(central);
+                for (std::size_t j = 0; j < errors.size(); ++j) errors_[j].push_back(errors[j]);
+                label_ids_.push_back(intern_labels(labels));
+        }
+        void append(const measurement& m) { append(m.central, m.errors, m.labels); }
+
+        // append a row of errors paired by their structure, with the
+        // elements() of the table
+        void append_elements(const number& central, std::span<const error_element> errors,
+                             const std::vector<std::string_view>& labels = {})
+        {
+                bool same = errors.size() == elements_.size();
+                for (std::size_t k = 0; same && k < errors.size(); ++k)
+                        same = std::holds_alternative<asym_error>(errors[k]) == (elements_[k] == element::asymmetric);
+                if (!same) detail::fail("# error: row of error elements not matching the elements of the table");
+                central_.push_back(central);
+                std::size_t j = 0;
+                for (const auto& e : errors) {
+                        std::visit([this, &j](const auto& v) {
+                                if constexpr (std::is_same_v<std::decay_t<decltype(v)>, asym_error>) {
+                                        errors_[j++].push_back(v.up);
+                                        errors_[j++].push_back(v.down);
+                                } else {
+                                        number n = v;
+                                        n.sgn = 0;
+                                        errors_[j++].push_back(n);
+                                }
+                        }, e);
+                }
+                label_ids_.push_back(intern_labels(labels));
+        }
+
+        // the layout of the rows of elements, empty for rows of `number`s
+        const std::vector<element>& elements() const noexcept { return elements_; }
+
+        row_view operator[](std::size_t i) const noexcept { return {this, i}; }
+
+        // direct access to the columns
+        const column& central() const noexcept { return central_; }
+        const column& errors(std::size_t j) const noexcept { return errors_[j]; }
+        const detail::aligned_vector<std::uint32_t>& label_ids() const noexcept { return label_ids_; }
+        const std::vector<std::string_view>& label_set(std::uint32_t id) const noexcept { return label_sets_[id]; }
+        std::size_t n_label_sets() const noexcept { return label_sets_.size(); }
+
+        // round and format every row, the labels stored with a row
+        // take precedence over `opt.labels`; with `opt.deduplicate`
+        // identical rows are rounded and formatted once
+        std::vector<std::string> format(const format_options& opt = {}) const
+        {
+                return format_all(opt, detail::builtin_rounder{});
+        }
+
+        // as above, rounding with the policy `P` instead of `opt.round`
+        template <rounding_policy P>
+        std::vector<std::string> format(const format_options& opt = {}) const
+        {
+                return format_all(opt, detail::policy_rounder<P>{});
+        }
+
+        // the structure of the errors of every row, when each error column
+        // has a single sign and the rounding keeps it (no symmetrization);
+        // finding it reads the signs of the whole table. None for a table
+        // of elements, whose structure is elements()
+        std::optional<error_schema> schema(const format_options& opt = {}) const
+        {
+                if (opt.symmetrize_errors || empty() || !elements_.empty()) return std::nullopt;
+                for (const auto& c : errors_)
+                        if (std::any_of(c.sgn.begin(), c.sgn.end(), [&](std::int8_t v) { return v != c.sgn[0]; }))
+                                return std::nullopt;
+                std::vector<number> e;
+                load_row(0, e);
+                return error_schema(e);
+        }
+
+        // round and format the rows [first, last) into the pre-allocated slots
+        // out[first, last), with out.size() == size(): disjoint ranges can be
+        // formatted concurrently, e.g. by chunks dispatched to a thread pool.
+        // `schema` is schema(opt), computed once for all the chunks (or null)
+        void format_to(std::span<std::string> out, std::size_t first, std::size_t last,
+                       const format_options& opt, const error_schema* schema) const
+        {
+                format_rows(out, first, last, opt, detail::builtin_rounder{}, schema);
+        }
+
+        template <rounding_policy P>
+        void format_to(std::span<std::string> out, std::size_t first, std::size_t last,
+                       const format_options& opt, const error_schema* schema) const
+        {
+                format_rows(out, first, last, opt, detail::policy_rounder<P>{}, schema);
+        }
+
+        // as above for a single range, finding the schema first
+        void format_to(std::span<std::string> out, std::size_t first, std::size_t last,
+                       const format_options& opt = {}) const
+        {
+                auto s = schema(opt);
+                format_to(out, first, last, opt, s ? &*s : nullptr);
+        }
+
+        template <rounding_policy P>
+        void format_to(std::span<std::string> out, std::size_t first, std::size_t last,
+                       const format_options& opt = {}) const
+        {
+                auto s = schema(opt);
+                format_to<P>(out, first, last, opt, s ? &*s : nullptr);
+        }
+
+        // rows per chunk of work: the columns read and the strings written
+        // by a chunk fit in a 256 KiB L2 cache
+        std::size_t chunk_rows() const noexcept
+        {
+                constexpr std::size_t l2_bytes = 256 * 1024;
+                std::size_t row_bytes = (1 + n_errors()) * (sizeof(std::uint64_t) + sizeof(std::int32_t) + sizeof(std::int8_t))
+                                        + sizeof(std::uint32_t) + sizeof(std::string);
+                return std::max<std::size_t>(64, l2_bytes / row_bytes);
+        }
+
+      private:
+        friend struct detail::table_chunks;
+
+        column central_;
+        std::vector<column> errors_;
+        detail::aligned_vector<std::uint32_t> label_ids_;
+        std::vector<std::vector<std::string_view>> label_sets_;
+        std::vector<element> elements_;
+
+        // reusable buffers for the errors of a row
+        struct row_buffer {
+                std::vector<number> errors;
+                std::vector<error_element> elements;
+        };
+
+        // round and format row `i`, `b` holds the reusable buffers;
+        // `schema` (if any) describes the errors of every row
+        template <typename Round>
+        std::string format_row(std::size_t i, row_buffer& b,
+                               const format_options& opt, Round& round,
+                               const error_schema* schema) const
+        {
+                format_options o = opt;
+                o.labels = label_ids_[i] ? &label_sets_[label_ids_[i]] : opt.labels;
+                if (!elements_.empty()) {
+                        number c = load_elements(i, b.elements);
+                        round(c, std::span<error_element>(b.elements), o);
+                        return formatter(o).format_elements(c, b.elements);
+                }
+                auto& e = b.errors;
+                number c = load_row(i, e);
+                e.resize(round(c, std::span<number>(e), o));
+                if (!schema) return formatter(o).format(c, e);
+                std::string out;
+                out.reserve(128);
+                formatter(o).format_to(out, c, e, *schema);
+                return out;
+        }
+
+        // format the rows [first, last), only those representing themselves
+        // if `rep` is given (see representatives())
+        template <typename Round>
+        void format_rows(std::span<std::string> out, std::size_t first, std::size_t last,
+                         const format_options& opt, Round&& round, const error_schema* schema,
+                         const std::vector<std::size_t>* rep = nullptr) const
+        {
+                row_buffer b;
+                for (std::size_t i = first; i < last; ++i) {
+                        if (rep && (*rep)[i] != i) continue;
+                        out[i] = format_row(i, b, opt, round, schema);
+                }
+        }
+
+        template <typename Round>
+        std::vector<std::string> format_all(const format_options& opt, Round&& round) const
+        {
+                std::vector<std::string> out(size());
+                auto sch = schema(opt);
+                const error_schema* s = sch ? &*sch : nullptr;
+                if (!opt.deduplicate) {
+                        format_rows(out, 0, size(), opt, round, s);
+                        return out;
+                }
+                // a representative always precedes the rows it stands for
+                std::vector<std::size_t> rep = representatives();
+                row_buffer b;
+                for (std::size_t i = 0; i < size(); ++i) {
+                        if (rep[i] == i) out[i] = format_row(i, b, opt, round, s);
+                        else out[i] = out[rep[i]];
+                }
+                return out;
+        }
+
+        // for each row, the index of the first row with the same numbers and labels
+        std::vector<std::size_t> representatives() const
+        {
+                auto hash = [this](std::size_t i) {
+                        std::size_t h = detail::hash_mix(label_ids_[i], central_.n[i]);
+                        h = detail::hash_mix(h, (std::uint64_t(std::uint32_t(central_.p[i])) << 8) | std::uint8_t(central_.sgn[i]));
+                        for (const auto& c : errors_) {
+                                h = detail::hash_mix(h, c.n[i]);
+                                h = detail::hash_mix(h, (std::uint64_t(std::uint32_t(c.p[i])) << 8) | std::uint8_t(c.sgn[i]));
+                        }
+                        return h;
+                };
+                auto same = [this](std::size_t a, std::size_t b) {
+                        auto same_in = [a, b](const column& c) {
+                                return c.n[a] == c.n[b] && c.p[a] == c.p[b] && c.sgn[a] == c.sgn[b];
+                        };
+                        return label_ids_[a] == label_ids_[b] && same_in(central_)
+                               && std::all_of(errors_.begin(), errors_.end(), same_in);
+                };
+                // open addressing over the row indices, at most half full
+                constexpr std::size_t none = ~std::size_t(0);
+                std::vector<std::size_t> slots(std::bit_ceil(2 * size() + 1), none);
+                const std::size_t mask = slots.size() - 1;
+                std::vector<std::size_t> rep(size());
+                for (std::size_t i = 0; i < size(); ++i) {
+                        std::size_t k = hash(i) & mask;
+                        while (slots[k] != none && !same(slots[k], i)) k = (k + 1) & mask;
+                        if (slots[k] == none) slots[k] = i;
+                        rep[i] = slots[k];
+                }
+                return rep;
+        }
+
+        // gather row `i` into a reusable error buffer, return the central value
+        number load_row(std::size_t i, std::vector<number>& e) const
+        {
+                e.resize(n_errors());
+                for (std::size_t j = 0; j < n_errors(); ++j) e[j] = errors_[j].get(i);
+                return central_.get(i);
+        }
+
+        // as above, for a table of elements
+        number load_elements(std::size_t i, std::vector<error_element>& e) const
+        {
+                e.resize(elements_.size());
+                for (std::size_t k = 0, j = 0; k < elements_.size(); ++k) {
+                        if (elements_[k] == element::asymmetric) {
+                                e[k] = asym_error(errors_[j].get(i), errors_[j + 1].get(i));
+                                j += 2;
+                        } else {
+                                e[k] = errors_[j++].get(i);
+                        }
+                }
+                return central_.get(i);
+        }
+
+        // the distinct label sets are few: a linear search is enough
+        std::uint32_t intern_labels(const std::vector<std::string_view>& labels)
+        {
+                if (labels.empty()) return 0;
+                for (std::size_t k = 1; k < label_sets_.size(); ++k)
+                        if (label_sets_[k] == labels) return static_cast<std::uint32_t>(k);
+                label_sets_.push_back(labels);
+                return static_cast<std::uint32_t>(label_sets_.size() - 1);
+        }
+};
+
+
+// Write the rows of a table as gnuplot data, rounding each row once:
+// the central value, one column per symmetric error and two (low, high)
+// per asymmetric pair, all as positive deltas, and the enhanced-text label
+// of the row in double quotes, e.g. with one asymmetric error
+//     plot 'file' using 0:1:($1-$2):($1+$3) with yerrorbars
+//     replot 'file' using 0:1:4 with labels
+// The columns follow the signs of the unrounded errors, so that rows
+// keep the same layout when a pair is symmetrized (its value is then
+// written in both columns). With a non-empty `block` the rows are
+// wrapped in the inline data block `$block << EOD ... EOD`.
+inline void write_gnuplot(std::FILE* f, const measurement_table& t,
+                          const format_options& opt = {}, std::string_view block = {})
+{
+        format_options o = opt;
+        o.mode = mode_type::gnuplot;
+        o.factorize_powers = false;
+
+        std::string buf;
+        buf.reserve(1 << 16);
+        auto flush = [&] {
+                std::fwrite(buf.data(), 1, buf.size(), f);
+                buf.clear();
+        };
+        auto column = [&](number n) {
+                n.sgn = 0;
+                buf += n.to_string();
+                buf += ' ';
+        };
+
+        if (!block.empty()) {
+                buf += '$';
+                buf += block;
+                buf += " << EOD\n";
+        }
+        std::vector<number> e;
+        std::vector<int> sgn(t.n_errors());
+        for (std::size_t i = 0; i < t.size(); ++i) {
+                auto row = t[i];
+                number c = row.central();
+                e.resize(t.n_errors());
+                for (std::size_t j = 0; j < e.size(); ++j) {
+                        e[j] = row.error(j);
+                        sgn[j] = e[j].sgn;
+                }
+                o.labels = row.label_id() ? &row.labels() : opt.labels;
+                e.resize(detail::round(c, std::span<number>(e), o));
+
+                buf += c.to_string();
+                buf += ' ';
+                for (std::size_t j = 0, k = 0; j < sgn.size() && k < e.size(); ++j, ++k) {
+                        if (sgn[j] == 0 || j + 1 == sgn.size() || sgn[j + 1] == 0) {
+                                column(e[k]);
+                        } else if (e[k].sgn == 0) { // symmetrized pair
+                                column(e[k]);
+                                column(e[k]);
+                                ++j;
+                        } else { // low, then high
+                                column(e[k].sgn < 0 ? e[k] : e[k + 1]);
+                                column(e[k].sgn < 0 ? e[k + 1] : e[k]);
+                                ++j;
+                                ++k;
+                        }
+                }
+                buf += '"';
+                for (char ch : formatter(o).format(c, e)) {
+                        if (ch == '"' || ch == '\\') buf += '\\';
+                        buf += ch;
+                }
+                buf += "\"\n";
+                if (buf.size() > (1 << 16) - 512) flush();
+        }
+        if (!block.empty()) buf += "EOD\n";
+        flush();
+}
+
+} // namespace rounder